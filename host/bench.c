@@ -0,0 +1,284 @@
+/*
+
+  bench.c
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Benchmarks the per-frame hot paths of laser.c on every level, and prints
+// the results as CSV. Build it natively (make bench) to get host TSC ticks,
+// or for the atmega644 (make bench.elf) and run it under simavr to get exact
+// AVR clock cycles. Every hot path runs on the solved board, which is where
+// the beam is longest.
+
+#define main laser_main
+#include "../laser.c"
+#undef main
+
+#include <stdio.h>
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "avr_mcu_section.h"
+
+AVR_MCU(F_CPU, "atmega644");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+#define BENCH_RUNS 4 // the simulator is cycle exact, so only TryRotation needs all four
+
+typedef uint32_t cycles_t;
+
+// Timer1 counts every clock cycle, and its overflows extend it to 32 bits
+static volatile uint16_t timerOverflows;
+
+ISR(TIMER1_OVF_vect)
+{
+  ++timerOverflows;
+}
+
+static void InitCycles(void)
+{
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TIMSK1 = _BV(TOIE1);
+  sei();
+}
+
+static cycles_t Cycles(void)
+{
+  const uint8_t sreg = SREG;
+  cli();
+  const uint16_t lo = TCNT1;
+  uint16_t hi = timerOverflows;
+  if ((TIFR1 & _BV(TOV1)) && (lo < 0x8000)) // overflowed, but the ISR hasn't run yet
+    ++hi;
+  SREG = sreg;
+  return ((cycles_t)hi << 16) | lo;
+}
+
+// simavr prints whatever is written to the console register
+static int ConsolePutChar(char c, FILE* stream)
+{
+  (void)stream;
+  GPIOR0 = c;
+  return 0;
+}
+
+static FILE console = FDEV_SETUP_STREAM(ConsolePutChar, NULL, _FDEV_SETUP_WRITE);
+#else
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define BENCH_RUNS 64 // keep the fastest run, to filter out the noise of the host OS
+
+typedef uint64_t cycles_t;
+
+static void InitCycles(void)
+{
+}
+
+static cycles_t Cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (cycles_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+#endif
+
+// Everything the game can do between two vsyncs has to fit in the lines that are not being rendered
+#define LINE_CYCLES 1820
+#define FRAME_LINES 262
+#define BENCH_BUDGET ((uint32_t)(FRAME_LINES - SCREEN_TILES_V * TILE_HEIGHT) * LINE_CYCLES)
+
+// The fastest of BENCH_RUNS calls, less the cost of reading the counter.
+// The setup runs before each call, and isn't timed.
+#define MEASURE_AFTER(result, setup, call)				\
+  do {									\
+    cycles_t best = ~(cycles_t)0;					\
+    for (uint8_t run = 0; run < BENCH_RUNS; ++run) {			\
+      setup;								\
+      const cycles_t start = Cycles();					\
+      call;								\
+      const cycles_t elapsed = Cycles() - start;			\
+      if (elapsed < best)						\
+	best = elapsed;							\
+    }									\
+    result = (best > overhead) ? (best - overhead) : 0;		\
+  } while (0)
+
+#define MEASURE(result, call) MEASURE_AFTER(result, , call)
+
+enum { B_LOAD_LEVEL, B_TRACE_LASER, B_DRAW_LASER, B_ERASE_LASER, B_TRY_ROTATION, B_IS_SOLVED, B_LASER_ON, B_HINT_STEP, B_COLUMNS };
+
+static const char* const columns[B_COLUMNS] = {
+  "load_level", "trace_laser", "draw_laser", "erase_laser", "try_rotation", "is_solved", "laser_on", "hint_step",
+};
+
+// The longest any one frame's share of the hint search takes, over the whole search
+#if defined(__AVR__)
+static cycles_t MeasureHintStep(const cycles_t overhead)
+{
+  cycles_t slowest = 0;
+  SolveBegin(1);
+  for (bool searched = false; !searched; ) {
+    const cycles_t start = Cycles();
+    searched = SolveStep(HINT_TRACES_PER_FRAME);
+    const cycles_t elapsed = Cycles() - start;
+    if (elapsed > slowest)
+      slowest = elapsed;
+  }
+  return (slowest > overhead) ? (slowest - overhead) : 0;
+}
+#else
+#define HINT_MAX_FRAMES 4096
+
+// The search goes the same way every time, so each of its frames keeps its fastest run
+static cycles_t MeasureHintStep(const cycles_t overhead)
+{
+  static cycles_t fastest[HINT_MAX_FRAMES];
+  uint16_t frames = 0;
+  for (uint8_t run = 0; run < BENCH_RUNS; ++run) {
+    SolveBegin(1);
+    frames = 0;
+    for (bool searched = false; !searched && (frames < HINT_MAX_FRAMES); ++frames) {
+      const cycles_t start = Cycles();
+      searched = SolveStep(HINT_TRACES_PER_FRAME);
+      const cycles_t elapsed = Cycles() - start;
+      if ((run == 0) || (elapsed < fastest[frames]))
+	fastest[frames] = elapsed;
+    }
+  }
+
+  cycles_t slowest = 0;
+  for (uint16_t i = 0; i < frames; ++i)
+    if (fastest[i] > slowest)
+      slowest = fastest[i];
+  return (slowest > overhead) ? (slowest - overhead) : 0;
+}
+#endif
+
+// Puts the hand pieces where the solver says they go, and leaves them movable
+static void PlaceSolution(void)
+{
+  Solve(1);
+  for (uint8_t i = 0; i < solutionPieces; ++i)
+    board[solutionCell[i] / BOARD_MAX_W][solutionCell[i] % BOARD_MAX_W] = solutionPiece[i];
+  memset(hand, P_BLANK, sizeof(hand));
+}
+
+// Points the "mouse cursor" at the first piece on the board that can be rotated
+static void AimAtMovablePiece(void)
+{
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x)
+      if (!(board[y][x] & 0x80) && (board[y][x] != P_BLANK)) {
+	sprites[MAX_SPRITES - 1].x = (10 + x * 4) * TILE_WIDTH;
+	sprites[MAX_SPRITES - 1].y = (2 + y * 4) * TILE_HEIGHT;
+	return;
+      }
+}
+
+int main(void)
+{
+#if defined(__AVR__)
+  stdout = &console;
+#endif
+  InitCycles();
+
+  cycles_t overhead = 0;
+  MEASURE(overhead, );
+
+  cycles_t worst[B_COLUMNS] = { 0 };
+  bool allSolved = true;
+
+  printf("# %s, frame budget %lu AVR cycles\n",
+#if defined(__AVR__)
+	 "AVR clock cycles",
+#else
+	 "host cycle counter ticks",
+#endif
+	 (unsigned long)BENCH_BUDGET);
+  printf("level");
+  for (uint8_t c = 0; c < B_COLUMNS; ++c)
+    printf(",%s", columns[c]);
+  printf("\n");
+
+  for (uint8_t level = 1; level <= LEVELS; ++level) {
+    cycles_t result[B_COLUMNS];
+    bool solved = false;
+
+    // Switching from the level before, since loading the one that's already on the screen draws nothing
+    MEASURE_AFTER(result[B_LOAD_LEVEL], LoadLevel((level == 1) ? LEVELS : level - 1), LoadLevel(level));
+    // The game starts searching for the hint on the level as it's loaded
+    result[B_HINT_STEP] = MeasureHintStep(overhead);
+    PlaceSolution();
+    MEASURE(result[B_TRACE_LASER], TraceLaser());
+    MEASURE(result[B_DRAW_LASER], DrawLaser());
+    MEASURE(result[B_IS_SOLVED], solved = IsSolved());
+    MEASURE(result[B_ERASE_LASER], EraseLaser());
+    // Pressing Y traces the laser, and draws the first of the squares it goes through in the same frame
+    MEASURE(result[B_LASER_ON], { TraceLaser(); DrawLaserStep(); });
+    EraseLaser();
+    AimAtMovablePiece();
+    MEASURE(result[B_TRY_ROTATION], TryRotation(rotateClockwise));
+
+    if (!solved)
+      allSolved = false;
+
+    printf("%u", (unsigned)level);
+    for (uint8_t c = 0; c < B_COLUMNS; ++c) {
+      printf(",%lu", (unsigned long)result[c]);
+      if (result[c] > worst[c])
+	worst[c] = result[c];
+    }
+    printf("\n");
+  }
+
+  printf("max");
+  for (uint8_t c = 0; c < B_COLUMNS; ++c)
+    printf(",%lu", (unsigned long)worst[c]);
+  printf("\n");
+
+  if (!allSolved)
+    printf("# error: the solution to at least one level was not recognized\n");
+
+  int status = allSolved ? 0 : 1;
+#if defined(__AVR__)
+  // Only the simulator's cycle counts can be held against the frame budget,
+  // and changing levels is allowed to drop a frame
+  for (uint8_t c = 0; c < B_COLUMNS; ++c)
+    if ((c != B_LOAD_LEVEL) && (worst[c] > BENCH_BUDGET)) {
+      printf("# error: %s is over the frame budget\n", columns[c]);
+      status = 1;
+    }
+
+  // Sleeping with interrupts off ends the simulation
+  cli();
+  sleep_enable();
+  sleep_cpu();
+#endif
+  return status;
+}
@@ -0,0 +1,363 @@
+/*
+
+  genlevels.c
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Makes up new levels. Mirrors and splitters are dropped one at a time
+// where the laser goes, then targets are put where the beam leaves the
+// board, and the layout is only kept if TraceLaser() lights every piece
+// in it. Some of the mirrors and splitters are then taken off the board
+// and put in the hand, and the level is only kept if Solve() finds that
+// it has exactly one solution.
+//
+// The game's state is all in globals, so instead of threads, the search
+// is spread over worker processes, which send the levels they find back
+// over a pipe. The levels are printed in the same format as
+// data/levels.inc, ready to be pasted in and packed with make levels,
+// and with -S, their solutions are written in the format of
+// data/solutions.inc. With -p, they are also written to a level pack file
+// for the SD card, so there can be more of them than fit in flash.
+//
+//   genlevels [-n levels] [-j workers] [-s seed] [-f first] [-w width] [-h height] [-S solutions] [-p pack]
+
+#define _DEFAULT_SOURCE
+
+#define main laser_main
+#include "../laser.c"
+#undef main
+
+#include "levelpack.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_WORKERS 64
+
+// A level, laid out the same way as in data/levels.inc and data/solutions.inc
+struct Level {
+  uint8_t source[2 + BOARD_MAX_W * BOARD_MAX_H + 5];
+  uint8_t solution[BOARD_MAX_W * BOARD_MAX_H];
+};
+
+static const char* const pieceNames[] = {
+  "0", "P_BLOCKER", "P_TARGET_T", "P_TARGET_R", "P_TARGET_B", "P_TARGET_L",
+  "P_MIRROR_BL", "P_MIRROR_TL", "P_MIRROR_TR", "P_MIRROR_BR", "P_SPLIT_TLBR", "P_SPLIT_TRBL",
+};
+
+// The number of layouts tried by all of the workers, shared between them
+static uint64_t* candidates;
+
+static uint32_t randomState;
+
+// xorshift32, so each worker has its own repeatable sequence
+static uint32_t Random(const uint32_t n)
+{
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState % n;
+}
+
+static uint8_t RandomRotation(uint8_t piece)
+{
+  for (uint8_t i = Random(4); i; --i)
+    piece = pgm_read_byte(&rotateClockwise[piece]);
+  return piece;
+}
+
+// Picks one of the blank squares that the beam goes through, or 0xFF if there aren't any
+static uint8_t RandomLitBlank(void)
+{
+  uint8_t choices[BOARD_MAX_W * BOARD_MAX_H];
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < litCount; ++i)
+    if (board[litCells[i] >> 4][litCells[i] & 0x0F] == P_BLANK)
+      choices[count++] = litCells[i];
+  return count ? choices[Random(count)] : 0xFF;
+}
+
+/* Lays out the mirrors, splitters and targets of a level on the board, so
+   that the laser lights every one of them, and returns how many mirrors
+   and splitters there are, or 0 if this attempt didn't work out
+*/
+static uint8_t BuildLayout(uint8_t placed[5])
+{
+  for (uint8_t y = 0; y < BOARD_MAX_H; ++y)
+    for (uint8_t x = 0; x < BOARD_MAX_W; ++x)
+      board[y][x] = ((x < boardWidth) && (y < boardHeight)) ? P_BLANK : (P_BLOCKER | 0x80);
+
+  const uint8_t pieces = 1 + Random(5);
+  bool split = false;
+  for (uint8_t i = 0; i < pieces; ++i) {
+    TraceLaser();
+    const uint8_t cell = RandomLitBlank();
+    if (cell == 0xFF)
+      return 0;
+    uint8_t piece;
+    if (!split && (Random(4) == 0)) { // only one splitter, so there are at most two targets
+      piece = P_SPLIT_TLBR + Random(2);
+      split = true;
+    } else {
+      piece = P_MIRROR_BL + Random(4);
+    }
+    board[cell >> 4][cell & 0x0F] = piece;
+    placed[i] = cell;
+  }
+
+  // Put a target on every square where the beam leaves the board, facing back into it
+  TraceLaser();
+  uint8_t targets = 0;
+  for (uint8_t i = 0; i < litCount; ++i) {
+    const uint8_t x = litCells[i] & 0x0F;
+    const uint8_t y = litCells[i] >> 4;
+    const uint8_t l = LaserAt(x, y);
+    uint8_t target = P_BLANK;
+    if ((l & D_OUT_L) && (x == 0))
+      target = P_TARGET_R;
+    else if ((l & D_OUT_R) && (x == boardWidth - 1))
+      target = P_TARGET_L;
+    else if ((l & D_OUT_T) && (y == 0))
+      target = P_TARGET_B;
+    else if ((l & D_OUT_B) && (y == boardHeight - 1))
+      target = P_TARGET_T;
+    if (target == P_BLANK)
+      continue;
+    if ((board[y][x] != P_BLANK) || (++targets > 2))
+      return 0;
+    board[y][x] = target;
+  }
+  if (targets == 0)
+    return 0;
+
+  TraceLaser();
+  if (!AllPiecesLit())
+    return 0;
+
+  // A few blockers where the beam doesn't go, to get in the way
+  for (uint8_t i = Random(3); i; --i) {
+    const uint8_t x = Random(boardWidth);
+    const uint8_t y = Random(boardHeight);
+    if ((board[y][x] == P_BLANK) && !LaserIn(y * BOARD_MAX_W + x) && !((x == 0) && (y == 1)))
+      board[y][x] = P_BLOCKER;
+  }
+  return pieces;
+}
+
+// Makes one level, and returns whether it has exactly one solution
+static bool MakeLevel(struct Level* const level)
+{
+  uint8_t placed[5];
+  const uint8_t pieces = BuildLayout(placed);
+  if (pieces == 0)
+    return false;
+
+  memset(level, 0, sizeof(*level));
+  level->source[0] = boardWidth;
+  level->source[1] = boardHeight;
+  uint8_t* const puzzle = &level->source[2];
+  uint8_t* const pieceHand = &level->source[2 + BOARD_MAX_W * BOARD_MAX_H];
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x)
+      level->solution[y * BOARD_MAX_W + x] = puzzle[y * BOARD_MAX_W + x] = board[y][x];
+
+  // Move some of the mirrors and splitters into the hand, turned any which way
+  uint8_t moving = 1 + Random(pieces);
+  uint8_t handPieces = 0;
+  for (uint8_t i = 0; (i < pieces) && moving; ++i)
+    if (Random(pieces - i) < moving) {
+      const uint8_t cell = (placed[i] >> 4) * BOARD_MAX_W + (placed[i] & 0x0F);
+      pieceHand[handPieces++] = RandomRotation(puzzle[cell]);
+      puzzle[cell] = P_BLANK;
+      --moving;
+    }
+
+  // Set it up the way LoadLevel() would, and make sure there's only the one way to solve it
+  for (uint8_t y = 0; y < BOARD_MAX_H; ++y)
+    for (uint8_t x = 0; x < BOARD_MAX_W; ++x)
+      board[y][x] = ((x < boardWidth) && (y < boardHeight)) ? (puzzle[y * BOARD_MAX_W + x] | 0x80) : (P_BLOCKER | 0x80);
+  memcpy(hand, pieceHand, sizeof(hand));
+  return Solve(2) == 1;
+}
+
+static void Worker(const int out, const uint32_t seed)
+{
+  randomState = seed ? seed : 1;
+  for (;;) {
+    struct Level level;
+    const bool found = MakeLevel(&level);
+    __atomic_add_fetch(candidates, 1, __ATOMIC_RELAXED);
+    if (found && (write(out, &level, sizeof(level)) != sizeof(level)))
+      _exit(EXIT_SUCCESS); // the pipe was closed, because there are enough levels
+  }
+}
+
+static void PrintPieces(FILE* const out, const uint8_t* const pieces, const uint8_t count)
+{
+  fprintf(out, " ");
+  for (uint8_t i = 0; i < count; ++i)
+    fprintf(out, " %s,", pieceNames[pieces[i]]);
+  fprintf(out, "\n");
+}
+
+static void PrintLevel(const struct Level* const level, const unsigned number, FILE* const solutions)
+{
+  printf("  // LEVEL %u\n", number);
+  printf("  // Size\n");
+  printf("  %u, %u,\n", level->source[0], level->source[1]);
+  printf("  // Puzzle\n");
+  for (uint8_t y = 0; y < BOARD_MAX_H; ++y)
+    PrintPieces(stdout, &level->source[2 + y * BOARD_MAX_W], BOARD_MAX_W);
+  printf("  // Hand\n");
+  PrintPieces(stdout, &level->source[2 + BOARD_MAX_W * BOARD_MAX_H], 5);
+  printf("\n");
+
+  if (solutions) {
+    fprintf(solutions, "  // LEVEL %u\n", number);
+    for (uint8_t y = 0; y < BOARD_MAX_H; ++y)
+      PrintPieces(solutions, &level->solution[y * BOARD_MAX_W], BOARD_MAX_W);
+    fprintf(solutions, "\n");
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned wanted = 10;
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t seed = (uint32_t)time(NULL);
+  unsigned first = LEVELS + 1;
+  unsigned width = BOARD_MAX_W;
+  unsigned height = BOARD_MAX_H;
+  const char* solutionsPath = NULL;
+  const char* packPath = NULL;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:j:s:f:w:h:S:p:")) != -1)
+    switch (option) {
+    case 'n': wanted = strtoul(optarg, NULL, 0); break;
+    case 'j': workers = strtol(optarg, NULL, 0); break;
+    case 's': seed = strtoul(optarg, NULL, 0); break;
+    case 'f': first = strtoul(optarg, NULL, 0); break;
+    case 'w': width = strtoul(optarg, NULL, 0); break;
+    case 'h': height = strtoul(optarg, NULL, 0); break;
+    case 'S': solutionsPath = optarg; break;
+    case 'p': packPath = optarg; break;
+    default:
+      fprintf(stderr, "usage: %s [-n levels] [-j workers] [-s seed] [-f first] [-w width] [-h height] [-S solutions] [-p pack]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  if ((width < 1) || (width > BOARD_MAX_W) || (height < 2) || (height > BOARD_MAX_H)) {
+    fprintf(stderr, "the board can be from 1x2 up to %ux%u\n", BOARD_MAX_W, BOARD_MAX_H);
+    return EXIT_FAILURE;
+  }
+  if (packPath && (wanted > LEVEL_PACK_MAX_LEVELS)) {
+    fprintf(stderr, "a pack can have at most %u levels\n", LEVEL_PACK_MAX_LEVELS);
+    return EXIT_FAILURE;
+  }
+  if (workers < 1)
+    workers = 1;
+  if (workers > MAX_WORKERS)
+    workers = MAX_WORKERS;
+  boardWidth = width;
+  boardHeight = height;
+
+  FILE* const solutions = solutionsPath ? fopen(solutionsPath, "w") : NULL;
+  if (solutionsPath && !solutions) {
+    perror(solutionsPath);
+    return EXIT_FAILURE;
+  }
+  FILE* const pack = packPath ? fopen(packPath, "wb") : NULL;
+  if (packPath && !pack) {
+    perror(packPath);
+    return EXIT_FAILURE;
+  }
+
+  candidates = mmap(NULL, sizeof(*candidates), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  int pipeEnds[2];
+  if ((candidates == MAP_FAILED) || (pipe(pipeEnds) != 0)) {
+    perror("genlevels");
+    return EXIT_FAILURE;
+  }
+  *candidates = 0;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pid_t pids[MAX_WORKERS];
+  for (long i = 0; i < workers; ++i) {
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      close(pipeEnds[0]);
+      Worker(pipeEnds[1], seed + (uint32_t)i * 0x9E3779B9u);
+    }
+  }
+  close(pipeEnds[1]);
+
+  // Levels are small enough that each one arrives in a single read
+  struct Level* const found = malloc(wanted * sizeof(struct Level));
+  unsigned count = 0;
+  while (count < wanted) {
+    struct Level level;
+    const ssize_t got = read(pipeEnds[0], &level, sizeof(level));
+    if ((got < 0) && (errno == EINTR))
+      continue;
+    if (got != sizeof(level))
+      break;
+    bool duplicate = false;
+    for (unsigned i = 0; (i < count) && !duplicate; ++i)
+      duplicate = !memcmp(found[i].source, level.source, sizeof(level.source));
+    if (duplicate)
+      continue;
+    found[count] = level;
+    PrintLevel(&found[count], first + count, solutions);
+    ++count;
+  }
+
+  for (long i = 0; i < workers; ++i)
+    kill(pids[i], SIGTERM);
+  for (long i = 0; i < workers; ++i)
+    waitpid(pids[i], NULL, 0);
+  close(pipeEnds[0]);
+  if (solutions)
+    fclose(solutions);
+  if (pack) {
+    bool written = WriteLevelPackHeader(pack, count);
+    for (unsigned i = 0; written && (i < count); ++i)
+      written = WriteLevelPackRecord(pack, found[i].source);
+    if ((fclose(pack) != 0) || !written) {
+      perror(packPath);
+      count = 0;
+    }
+  }
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  const double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf(stderr, "%u levels from %llu candidates in %.2f s (%.0f candidates/s, %ld workers)\n", count,
+	  (unsigned long long)*candidates, seconds, *candidates / seconds, workers);
+
+  free(found);
+  return (count == wanted) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,333 @@
+/*
+
+  kernel.c
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Headless stand-in for the Uzebox kernel, so laser.c can be built and run
+// natively. Video calls update an in-memory copy of VRAM and the sprite
+// table, sound calls are ignored, and ReadJoypad() takes one joypad word
+// per frame from stdin (e.g. "0x0100" for BTN_A), exiting at end of input.
+// Tools can read the words from somewhere else by setting joypadSource, and
+// if LASER_RECORD names a file, every word read is also written to it, in
+// the same format, so the session can be played back later.
+// EEPROM blocks are kept in memory, and also in the file named by the
+// LASER_EEPROM environment variable if it is set, so progress can be
+// carried from one run to the next.
+// The SD card is a directory, named by the LASER_SD environment variable,
+// with the files that would be in the root of the card. Without it, there
+// is no card, unless a host tool has set sdFileName to read from.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <uzebox.h>
+#include <petitfatfs/pff.h>
+
+struct SpriteStruct sprites[MAX_SPRITES];
+u8 vram[VRAM_TILES_H * VRAM_TILES_V];
+
+// The number of frames that have gone by, as counted by WaitVsync()
+uint32_t frameCount;
+
+// The number of tiles written to VRAM, by SetTile() and DrawMap()
+uint32_t tileWrites;
+
+void SetTileTable(const char* data)
+{
+  (void)data;
+}
+
+void SetSpritesTileBank(u8 bank, const char* tileData)
+{
+  (void)bank;
+  (void)tileData;
+}
+
+void SetTile(char x, char y, unsigned int tileId)
+{
+  vram[(u8)y * VRAM_TILES_H + (u8)x] = (u8)tileId;
+  ++tileWrites;
+}
+
+void DrawMap(u8 x, u8 y, const VRAM_PTR_TYPE* map)
+{
+  const u8 width = pgm_read_byte(&map[0]);
+  const u8 height = pgm_read_byte(&map[1]);
+  for (u8 dy = 0; dy < height; ++dy)
+    for (u8 dx = 0; dx < width; ++dx)
+      SetTile(x + dx, y + dy, pgm_read_byte(&map[2 + dy * width + dx]));
+}
+
+void MapSprite2(u8 startSprite, const char* map, u8 spriteFlags)
+{
+  const u8 width = pgm_read_byte(&map[0]);
+  const u8 height = pgm_read_byte(&map[1]);
+  for (u8 i = 0; i < width * height; ++i) {
+    sprites[startSprite + i].tileIndex = pgm_read_byte(&map[2 + i]);
+    sprites[startSprite + i].flags = spriteFlags;
+  }
+}
+
+void MoveSprite(u8 startSprite, u8 x, u8 y, u8 width, u8 height)
+{
+  for (u8 dy = 0; dy < height; ++dy)
+    for (u8 dx = 0; dx < width; ++dx) {
+      sprites[startSprite].x = x + dx * TILE_WIDTH;
+      sprites[startSprite].y = y + dy * TILE_HEIGHT;
+      ++startSprite;
+    }
+}
+
+void WaitVsync(int count)
+{
+  frameCount += count;
+}
+
+static unsigned int ReadStdinJoypad(void)
+{
+  char line[32];
+  if (!fgets(line, sizeof(line), stdin))
+    exit(EXIT_SUCCESS);
+  return (unsigned int)strtoul(line, NULL, 0);
+}
+
+unsigned int (*joypadSource)(void) = ReadStdinJoypad;
+
+unsigned int ReadJoypad(unsigned char joypadNo)
+{
+  (void)joypadNo;
+  const unsigned int word = joypadSource();
+#if !defined(__AVR__)
+  static FILE* record = NULL;
+  static bool opened = false;
+  if (!opened) {
+    const char* const path = getenv("LASER_RECORD");
+    record = path ? fopen(path, "w") : NULL;
+    opened = true;
+  }
+  if (record) {
+    fprintf(record, "0x%04x\n", word);
+    fflush(record);
+  }
+#endif
+  return word;
+}
+
+// The same layout as the kernel's: 64 blocks of 32 bytes, the first one being
+// the signature. Under simavr that would be half of RAM, so there are fewer.
+#if defined(__AVR__)
+#define EEPROM_BLOCKS 4
+#else
+#define EEPROM_BLOCKS 64
+#endif
+#define EEPROM_SIGNATURE 0x555A
+#define EEPROM_FREE_BLOCK 0xFFFF
+
+static struct EepromBlockStruct eeprom[EEPROM_BLOCKS];
+static bool eepromLoaded = false;
+
+static void LoadEeprom(void)
+{
+  if (eepromLoaded)
+    return;
+  eepromLoaded = true;
+  memset(eeprom, 0xFF, sizeof(eeprom)); // erased, and not formatted
+
+#if !defined(__AVR__) // avr-libc has no files, so under simavr the blocks only live in memory
+  const char* const path = getenv("LASER_EEPROM");
+  FILE* const file = path ? fopen(path, "rb") : NULL;
+  if (file) {
+    if (fread(eeprom, 1, sizeof(eeprom), file) != sizeof(eeprom))
+      memset(eeprom, 0xFF, sizeof(eeprom));
+    fclose(file);
+  }
+#endif
+}
+
+static void StoreEeprom(void)
+{
+#if !defined(__AVR__)
+  const char* const path = getenv("LASER_EEPROM");
+  FILE* const file = path ? fopen(path, "wb") : NULL;
+  if (file) {
+    fwrite(eeprom, 1, sizeof(eeprom), file);
+    fclose(file);
+  }
+#endif
+}
+
+bool isEepromFormatted(void)
+{
+  LoadEeprom();
+  return eeprom[0].id == EEPROM_SIGNATURE;
+}
+
+void FormatEeprom(void)
+{
+  LoadEeprom();
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  eeprom[0].id = EEPROM_SIGNATURE;
+  StoreEeprom();
+}
+
+char EepromWriteBlock(struct EepromBlockStruct* block)
+{
+  if (!isEepromFormatted())
+    return EEPROM_ERROR_NOT_FORMATTED;
+  if ((block->id == EEPROM_FREE_BLOCK) || (block->id == EEPROM_SIGNATURE))
+    return EEPROM_ERROR_INVALID_BLOCK;
+
+  u8 free = 0;
+  for (u8 i = 1; i < EEPROM_BLOCKS; ++i) {
+    if (eeprom[i].id == block->id) {
+      free = i;
+      break;
+    }
+    if ((free == 0) && (eeprom[i].id == EEPROM_FREE_BLOCK))
+      free = i;
+  }
+  if (free == 0)
+    return EEPROM_ERROR_FULL;
+  eeprom[free] = *block;
+  StoreEeprom();
+  return 0;
+}
+
+char EepromReadBlock(unsigned int blockId, struct EepromBlockStruct* block)
+{
+  if (!isEepromFormatted())
+    return EEPROM_ERROR_NOT_FORMATTED;
+  for (u8 i = 1; i < EEPROM_BLOCKS; ++i)
+    if (eeprom[i].id == blockId) {
+      *block = eeprom[i];
+      return 0;
+    }
+  return EEPROM_ERROR_BLOCK_NOT_FOUND;
+}
+
+// The number of bytes read from the SD card, by pf_read()
+uint32_t sdBytesRead;
+
+// A host tool can set this to a file that is opened in place of any file on the card
+const char* sdFileName = NULL;
+
+#if !defined(__AVR__)
+static FATFS* sdMounted = NULL;
+static FILE* sdFile = NULL;
+#endif
+
+FRESULT pf_mount(FATFS* fs)
+{
+#if defined(__AVR__)
+  (void)fs;
+  return FR_NOT_READY;
+#else
+  if (!getenv("LASER_SD") && !sdFileName)
+    return FR_NOT_READY;
+  memset(fs, 0, sizeof(*fs));
+  sdMounted = fs;
+  return FR_OK;
+#endif
+}
+
+FRESULT pf_open(const char* path)
+{
+#if defined(__AVR__)
+  (void)path;
+  return FR_NOT_ENABLED;
+#else
+  if (!sdMounted)
+    return FR_NOT_ENABLED;
+  if (sdFile)
+    fclose(sdFile);
+  sdMounted->flag = 0;
+
+  char fullPath[4096];
+  if (sdFileName)
+    snprintf(fullPath, sizeof(fullPath), "%s", sdFileName);
+  else
+    snprintf(fullPath, sizeof(fullPath), "%s/%s", getenv("LASER_SD"), path);
+  sdFile = fopen(fullPath, "rb");
+  if (!sdFile)
+    return FR_NO_FILE;
+  fseek(sdFile, 0, SEEK_END);
+  sdMounted->fsize = (DWORD)ftell(sdFile);
+  fseek(sdFile, 0, SEEK_SET);
+  sdMounted->fptr = 0;
+  sdMounted->flag = 1; // open
+  return FR_OK;
+#endif
+}
+
+FRESULT pf_read(void* buff, UINT btr, UINT* br)
+{
+  *br = 0;
+#if defined(__AVR__)
+  (void)buff;
+  (void)btr;
+  return FR_NOT_ENABLED;
+#else
+  if (!sdMounted)
+    return FR_NOT_ENABLED;
+  if (!sdFile)
+    return FR_NOT_OPENED;
+  *br = (UINT)fread(buff, 1, btr, sdFile); // like the real one, reading stops at the end of the file
+  sdMounted->fptr += *br;
+  sdBytesRead += *br;
+  return ferror(sdFile) ? FR_DISK_ERR : FR_OK;
+#endif
+}
+
+FRESULT pf_lseek(DWORD ofs)
+{
+#if defined(__AVR__)
+  (void)ofs;
+  return FR_NOT_ENABLED;
+#else
+  if (!sdMounted)
+    return FR_NOT_ENABLED;
+  if (!sdFile)
+    return FR_NOT_OPENED;
+  if (ofs > sdMounted->fsize) // the real one clips seeks to the end of the file
+    ofs = sdMounted->fsize;
+  sdMounted->fptr = ofs;
+  return fseek(sdFile, ofs, SEEK_SET) ? FR_DISK_ERR : FR_OK;
+#endif
+}
+
+void InitMusicPlayer(const struct PatchStruct* patchPointersParam)
+{
+  (void)patchPointersParam;
+}
+
+void StartSong(const char* song)
+{
+  (void)song;
+}
+
+void TriggerNote(u8 channel, u8 patch, u8 note, u8 volume)
+{
+  (void)channel;
+  (void)patch;
+  (void)note;
+  (void)volume;
+}
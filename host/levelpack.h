@@ -0,0 +1,100 @@
+/*
+
+  levelpack.h
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Packing levels into the format LoadLevel() reads, shared by the host
+// tools that make levels. It needs laser.c to be included first. A level
+// is given the way it is laid out in data/levels.inc: the width and height,
+// the BOARD_MAX_W x BOARD_MAX_H squares of the puzzle, then the 5 pieces in
+// the hand.
+
+#ifndef HOST_LEVELPACK_H
+#define HOST_LEVELPACK_H
+
+#include <stdio.h>
+
+// Packs one level, and returns how many bytes it took, or 0 if the level doesn't fit
+static uint8_t PackLevel(const uint8_t* const source, uint8_t* const packed)
+{
+  const uint8_t width = source[0];
+  const uint8_t height = source[1];
+  const uint8_t* const puzzle = &source[2];
+  const uint8_t* const pieces = &source[2 + BOARD_MAX_W * BOARD_MAX_H];
+  if ((width < 1) || (width > BOARD_MAX_W) || (height < 2) || (height > BOARD_MAX_H))
+    return 0;
+
+  uint8_t size = 2;
+
+  uint8_t skip = 0;
+  for (uint8_t y = 0; y < BOARD_MAX_H; ++y)
+    for (uint8_t x = 0; x < BOARD_MAX_W; ++x) {
+      const uint8_t piece = puzzle[y * BOARD_MAX_W + x];
+      if ((x >= width) || (y >= height)) {
+	if (piece != P_BLANK)
+	  return 0;
+	continue;
+      }
+      if (piece == P_BLANK) {
+	++skip;
+	continue;
+      }
+      while (skip > 15) { // skip 16 squares, by skipping 15 and then placing a blank
+	packed[size++] = 0xF0 | P_BLANK;
+	skip -= 16;
+      }
+      packed[size++] = (skip << 4) | piece;
+      skip = 0;
+    }
+  const uint8_t boardBytes = size - 2;
+
+  uint8_t handPieces = 0;
+  for (uint8_t i = 0; i < 5; ++i)
+    if (pieces[i] != P_BLANK) {
+      if (handPieces & 1)
+	packed[size - 1] |= pieces[i];
+      else
+	packed[size++] = pieces[i] << 4;
+      ++handPieces;
+    }
+
+  packed[0] = (handPieces << 5) | boardBytes;
+  packed[1] = (width << 4) | height;
+  return size;
+}
+
+// Writes the header of a level pack (see the comment above LEVEL_RECORD_BYTES in laser.c)
+static bool WriteLevelPackHeader(FILE* const out, const unsigned levels)
+{
+  const uint8_t header[LEVEL_RECORD_BYTES] = {
+    'L', 'P', 'A', 'K', LEVEL_RECORD_BYTES, 0, levels & 0xFF, levels >> 8
+  };
+  return fwrite(header, 1, sizeof(header), out) == sizeof(header);
+}
+
+// Packs one level and writes it as a level pack record, or returns false if it doesn't fit
+static bool WriteLevelPackRecord(FILE* const out, const uint8_t* const source)
+{
+  uint8_t record[LEVEL_RECORD_BYTES] = {0};
+  return PackLevel(source, record) && (fwrite(record, 1, sizeof(record), out) == sizeof(record));
+}
+
+#endif // HOST_LEVELPACK_H
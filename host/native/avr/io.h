@@ -0,0 +1,30 @@
+/*
+
+  avr/io.h
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Host stand-in for the AVR register definitions. The game code does not
+// touch any registers directly, so there is nothing to define here.
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#endif // HOST_AVR_IO_H
@@ -0,0 +1,119 @@
+/*
+
+  packlevels.c
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Packs the levels in data/levels.inc into the format LoadLevel() reads
+// (see the comment above LevelAddress() in laser.c), and prints them as
+// C source for data/levels_packed.inc. With -p, they are written to a
+// level pack file for the SD card instead.
+//
+//   packlevels [-p pack]
+
+// This writes data/levels_packed.inc, so it mustn't be built from it, or
+// a run that fails half way through would leave it unable to build again.
+// None of the game's own levels are needed here.
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#define LEVELS 0
+const uint8_t levelData[] PROGMEM = { 0 };
+
+#define main laser_main
+#include "../laser.c"
+#undef main
+
+#include "../data/levels.inc"
+#include "levelpack.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define SOURCE_LEVELS (sizeof(levelSource) / LEVEL_SOURCE_SIZE)
+
+static int WritePack(const char* const path)
+{
+  if (SOURCE_LEVELS > LEVEL_PACK_MAX_LEVELS) {
+    fprintf(stderr, "%u levels is too many, a pack can have at most %u\n", (unsigned)SOURCE_LEVELS, LEVEL_PACK_MAX_LEVELS);
+    return EXIT_FAILURE;
+  }
+  FILE* const out = fopen(path, "wb");
+  if (!out) {
+    perror(path);
+    return EXIT_FAILURE;
+  }
+  bool written = WriteLevelPackHeader(out, SOURCE_LEVELS);
+  for (unsigned level = 0; written && (level < SOURCE_LEVELS); ++level)
+    if (!WriteLevelPackRecord(out, &levelSource[level * LEVEL_SOURCE_SIZE])) {
+      fprintf(stderr, "level %u doesn't fit on a %ux%u board\n", level + 1, BOARD_MAX_W, BOARD_MAX_H);
+      written = false;
+    }
+  if ((fclose(out) != 0) || !written) {
+    remove(path);
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "%u levels written to %s\n", (unsigned)SOURCE_LEVELS, path);
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+  int option;
+  while ((option = getopt(argc, argv, "p:")) != -1)
+    switch (option) {
+    case 'p':
+      return WritePack(optarg);
+    default:
+      fprintf(stderr, "usage: %s [-p pack]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  if (SOURCE_LEVELS > 255) { // the game counts levels in a uint8_t
+    fprintf(stderr, "%u levels is too many, there can be at most 255\n", (unsigned)SOURCE_LEVELS);
+    return EXIT_FAILURE;
+  }
+
+  printf("/*\n"
+	 " * Generated by host/packlevels from data/levels.inc, do not edit.\n"
+	 " * See LevelAddress() in laser.c for the format.\n"
+	 " */\n"
+	 "#define LEVELS %u\n"
+	 "const uint8_t levelData[] PROGMEM = {\n", (unsigned)SOURCE_LEVELS);
+
+  unsigned total = 0;
+  for (unsigned level = 0; level < SOURCE_LEVELS; ++level) {
+    const uint8_t* const source = &levelSource[level * LEVEL_SOURCE_SIZE];
+    uint8_t packed[2 + BOARD_MAX_W * BOARD_MAX_H + 3];
+    const uint8_t size = PackLevel(source, packed);
+    if (size == 0) {
+      fprintf(stderr, "level %u doesn't fit on a %ux%u board\n", level + 1, BOARD_MAX_W, BOARD_MAX_H);
+      return EXIT_FAILURE;
+    }
+    printf("  // LEVEL %u\n ", level + 1);
+    for (uint8_t i = 0; i < size; ++i)
+      printf(" 0x%02x,", packed[i]);
+    printf("\n");
+    total += size;
+  }
+  printf("};\n");
+
+  fprintf(stderr, "%u levels packed into %u bytes\n", (unsigned)SOURCE_LEVELS, total);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+/*
+
+  pff.h
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Headless stand-in for the parts of the kernel's Petit FatFs (the SD card
+// file system) that the game uses. kernel.c supplies the implementations,
+// which read from a directory on the host instead of a card.
+
+#ifndef HOST_PFF_H
+#define HOST_PFF_H
+
+#include <stdint.h>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+
+typedef struct {
+  BYTE fs_type;
+  BYTE flag;
+  WORD id;
+  DWORD fsize;
+  DWORD fptr;
+} FATFS;
+
+typedef enum {
+  FR_OK = 0,
+  FR_DISK_ERR,
+  FR_NOT_READY,
+  FR_NO_FILE,
+  FR_NOT_OPENED,
+  FR_NOT_ENABLED,
+  FR_NO_FILESYSTEM
+} FRESULT;
+
+FRESULT pf_mount(FATFS* fs);
+FRESULT pf_open(const char* path);
+FRESULT pf_read(void* buff, UINT btr, UINT* br);
+FRESULT pf_lseek(DWORD ofs);
+
+#endif // HOST_PFF_H
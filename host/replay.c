@@ -0,0 +1,375 @@
+/*
+
+  replay.c
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Plays a recorded session (one joypad word per frame, as written by the
+// host kernel when LASER_RECORD is set) through the game, and when the
+// input runs out, prints the board, hand, laser and VRAM, along with how
+// many tiles were written. With -g, that is compared against a golden
+// file instead, and the exit status says whether it matched. With -s, the
+// joypad words come from a scripted player that solves the given level,
+// so sessions can be made for every level without a controller (the level
+// comes from the level pack, if LASER_SD has one). With -t, the time taken
+// by each frame is reported on stderr. With -p, the game is built with frame
+// profiling (see FRAME_PROFILE in laser.c), and the time each part of the
+// main loop took in each frame is written to a CSV file.
+//
+//   replay [-s level] [-g golden] [-t] [-p profile] [session]
+
+#define _POSIX_C_SOURCE 200809L
+
+#define FRAME_PROFILE 1
+#define main laser_main
+#include "../laser.c"
+#undef main
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+extern uint32_t tileWrites;
+extern unsigned int (*joypadSource)(void);
+
+static FILE* session;
+static const char* goldenPath = NULL;
+static bool timing = false;
+static FILE* profile = NULL;
+
+// Per frame statistics, gathered between calls to the joypad source
+static uint32_t frames = 0;
+static uint32_t lastTileWrites = 0;
+static uint32_t maxFrameTileWrites = 0;
+static struct timespec lastTime;
+static double maxFrameUs = 0;
+static double totalFrameUs = 0;
+
+static void PrintState(FILE* out)
+{
+  fprintf(out, "frames %lu\n", (unsigned long)frames);
+  fprintf(out, "tile_writes %lu\n", (unsigned long)tileWrites);
+  fprintf(out, "max_frame_tile_writes %lu\n", (unsigned long)maxFrameTileWrites);
+  fprintf(out, "cursor %u %u\n", sprites[MAX_SPRITES - 1].x, sprites[MAX_SPRITES - 1].y);
+
+  fprintf(out, "board\n");
+  for (uint8_t y = 0; y < BOARD_MAX_H; ++y) {
+    for (uint8_t x = 0; x < BOARD_MAX_W; ++x)
+      fprintf(out, " %02x", board[y][x]);
+    fprintf(out, "\n");
+  }
+  fprintf(out, "hand\n");
+  for (uint8_t i = 0; i < 5; ++i)
+    fprintf(out, " %02x", hand[i]);
+  fprintf(out, "\n");
+  fprintf(out, "laser\n");
+  for (uint8_t y = 0; y < BOARD_MAX_H; ++y) {
+    for (uint8_t x = 0; x < BOARD_MAX_W; ++x)
+      fprintf(out, " %02x", LaserAt(x, y));
+    fprintf(out, "\n");
+  }
+  fprintf(out, "vram\n");
+  for (uint8_t v = 0; v < VRAM_TILES_V; ++v) {
+    for (uint8_t h = 0; h < VRAM_TILES_H; ++h)
+      fprintf(out, "%02x", vram[v * VRAM_TILES_H + h]);
+    fprintf(out, "\n");
+  }
+}
+
+// Compares the state against the golden file, and reports the first line that differs
+static bool MatchesGolden(void)
+{
+  char* state = NULL;
+  size_t stateSize = 0;
+  FILE* const out = open_memstream(&state, &stateSize);
+  PrintState(out);
+  fclose(out);
+
+  FILE* const golden = fopen(goldenPath, "r");
+  if (!golden) {
+    perror(goldenPath);
+    free(state);
+    return false;
+  }
+
+  bool match = true;
+  unsigned lineNumber = 1;
+  const char* expected = state;
+  char line[128];
+  while (match && fgets(line, sizeof(line), golden)) {
+    const size_t length = strlen(line);
+    if (strncmp(line, expected, length) != 0) {
+      const char* const end = strchr(expected, '\n');
+      fprintf(stderr, "%s:%u: expected %s", goldenPath, lineNumber, line);
+      fprintf(stderr, "%s:%u:      got %.*s\n", goldenPath, lineNumber,
+	      end ? (int)(end - expected) : (int)strlen(expected), expected);
+      match = false;
+    }
+    expected += length;
+    ++lineNumber;
+  }
+  if (match && *expected) {
+    fprintf(stderr, "%s:%u: the golden file ends early\n", goldenPath, lineNumber);
+    match = false;
+  }
+
+  fclose(golden);
+  free(state);
+  return match;
+}
+
+// Called when the input runs out, instead of returning to the game
+static void Finish(void)
+{
+  if (profile)
+    fclose(profile);
+  if (timing)
+    fprintf(stderr, "frames %lu, max %.1f us, mean %.1f us per frame\n", (unsigned long)frames,
+	    maxFrameUs, frames ? totalFrameUs / frames : 0.0);
+
+  if (goldenPath)
+    exit(MatchesGolden() ? EXIT_SUCCESS : EXIT_FAILURE);
+  PrintState(stdout);
+  exit(EXIT_SUCCESS);
+}
+
+// Accounts for the frame that just finished, which started at the last call
+static void EndFrame(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (frames) {
+    const double us = (now.tv_sec - lastTime.tv_sec) * 1e6 + (now.tv_nsec - lastTime.tv_nsec) / 1e3;
+    totalFrameUs += us;
+    if (us > maxFrameUs)
+      maxFrameUs = us;
+    if (tileWrites - lastTileWrites > maxFrameTileWrites)
+      maxFrameTileWrites = tileWrites - lastTileWrites;
+  }
+  lastTime = now;
+  lastTileWrites = tileWrites;
+
+  // The game has just finished timing the frame before this one
+  if (profile && frames) {
+    uint32_t total = 0;
+    fprintf(profile, "%lu", (unsigned long)frames);
+    for (uint8_t i = 0; i < PROFILE_PARTS; ++i) {
+      fprintf(profile, ",%lu", (unsigned long)profileLast[i]);
+      total += profileLast[i];
+    }
+    fprintf(profile, ",%lu\n", (unsigned long)total);
+  }
+  ++frames;
+}
+
+static unsigned int ReadSession(void)
+{
+  EndFrame();
+  char line[32];
+  if (!fgets(line, sizeof(line), session))
+    Finish();
+  return (unsigned int)strtoul(line, NULL, 0);
+}
+
+/* The scripted player: it picks the level with the next button, then drags
+   each piece from the hand to where Solve() says it goes, rotates it into
+   place, and holds the laser on until all of the beam is drawn. It steers the cursor by watching where it
+   is, so it doesn't depend on how fast the cursor moves.
+*/
+enum { AUTO_TITLE, AUTO_FIND_LEVEL, AUTO_TAKE, AUTO_DRAG, AUTO_ROTATE, AUTO_LASER, AUTO_BEAM };
+
+static uint8_t autoState = AUTO_TITLE;
+static unsigned int autoHeld = 0; // the buttons being held down, between taps
+static bool autoReleasing = false;
+static uint8_t autoBoard[BOARD_MAX_H][BOARD_MAX_W];
+static uint8_t autoHand[5];
+static uint8_t autoPieces;
+static uint8_t autoNext;
+static uint8_t autoSlot[5]; // the hand slot each solution piece comes from
+static uint8_t autoCell[5];
+static uint8_t autoRotations[5];
+
+static bool PlanSolution(const uint16_t level)
+{
+  LoadLevel(level);
+  memcpy(autoBoard, board, sizeof(board));
+  memcpy(autoHand, hand, sizeof(hand));
+  if (Solve(1) == 0)
+    return false;
+
+  uint8_t used = 0;
+  autoPieces = solutionPieces;
+  for (uint8_t i = 0; i < solutionPieces; ++i) {
+    uint8_t slot = 0;
+    while ((slot < 5) && ((used & (1 << slot)) || !IsRotationOf(solutionPiece[i], hand[slot])))
+      ++slot;
+    if (slot == 5)
+      return false;
+    used |= 1 << slot;
+    autoSlot[i] = slot;
+    autoCell[i] = solutionCell[i];
+    autoRotations[i] = 0;
+    for (uint8_t piece = hand[slot]; piece != solutionPiece[i]; piece = pgm_read_byte(&rotateClockwise[piece]))
+      ++autoRotations[i];
+  }
+  return true;
+}
+
+static bool CursorAt(const uint8_t tx, const uint8_t ty)
+{
+  return (sprites[MAX_SPRITES - 1].x / TILE_WIDTH == tx) && (sprites[MAX_SPRITES - 1].y / TILE_HEIGHT == ty);
+}
+
+static unsigned int Steer(const uint8_t tx, const uint8_t ty)
+{
+  const uint8_t cx = sprites[MAX_SPRITES - 1].x / TILE_WIDTH;
+  const uint8_t cy = sprites[MAX_SPRITES - 1].y / TILE_HEIGHT;
+  return ((cx < tx) ? BTN_RIGHT : (cx > tx) ? BTN_LEFT : 0) | ((cy < ty) ? BTN_DOWN : (cy > ty) ? BTN_UP : 0);
+}
+
+// Presses a button for one frame, on top of anything being held
+static unsigned int Tap(const unsigned int button)
+{
+  autoReleasing = true;
+  return autoHeld | button;
+}
+
+static unsigned int AutoPlay(void)
+{
+  EndFrame();
+  if (autoReleasing) {
+    autoReleasing = false;
+    return autoHeld;
+  }
+
+  switch (autoState) {
+  case AUTO_TITLE:
+    autoState = AUTO_FIND_LEVEL;
+    return Tap(BTN_A);
+
+  case AUTO_FIND_LEVEL:
+    if (!memcmp(board, autoBoard, sizeof(board)) && !memcmp(hand, autoHand, sizeof(hand))) {
+      autoState = AUTO_TAKE;
+      autoNext = 0;
+      return 0;
+    }
+    if (!CursorAt(PREV_NEXT_X + 2, PREV_NEXT_Y))
+      return Steer(PREV_NEXT_X + 2, PREV_NEXT_Y);
+    return Tap(BTN_A);
+
+  case AUTO_TAKE:
+    if (autoNext == autoPieces) {
+      autoState = AUTO_LASER;
+      return 0;
+    }
+    if (!CursorAt(10 + autoSlot[autoNext] * 4, 24))
+      return Steer(10 + autoSlot[autoNext] * 4, 24);
+    autoHeld = BTN_A;
+    autoState = AUTO_DRAG;
+    return autoHeld;
+
+  case AUTO_DRAG: {
+    const uint8_t tx = 10 + (autoCell[autoNext] % BOARD_MAX_W) * 4;
+    const uint8_t ty = 2 + (autoCell[autoNext] / BOARD_MAX_W) * 4;
+    if (!CursorAt(tx, ty))
+      return autoHeld | Steer(tx, ty);
+    autoHeld = 0; // letting go drops it
+    autoState = AUTO_ROTATE;
+    return autoHeld;
+  }
+
+  case AUTO_ROTATE:
+    if (autoRotations[autoNext]) {
+      --autoRotations[autoNext];
+      return Tap(BTN_X);
+    }
+    ++autoNext;
+    autoState = AUTO_TAKE;
+    return 0;
+
+  case AUTO_LASER:
+    autoState = AUTO_BEAM;
+    return BTN_Y;
+
+  case AUTO_BEAM: // keep holding the button until the whole beam has been drawn
+    if (laserShown != litCount)
+      return BTN_Y;
+    Finish();
+    return 0;
+
+  default:
+    Finish();
+    return 0;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int level = 0;
+  int option;
+  while ((option = getopt(argc, argv, "s:g:tp:")) != -1)
+    switch (option) {
+    case 's':
+      level = atoi(optarg);
+      break;
+    case 'g':
+      goldenPath = optarg;
+      break;
+    case 't':
+      timing = true;
+      break;
+    case 'p':
+      profile = fopen(optarg, "w");
+      if (!profile) {
+	perror(optarg);
+	return EXIT_FAILURE;
+      }
+      fprintf(profile, "frame,input_ns,trace_ns,draw_ns,erase_ns,drag_ns,rotate_ns,load_ns,hint_ns,total_ns\n");
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-s level] [-g golden] [-t] [-p profile] [session]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  if (level) {
+#if LEVEL_PACK
+    OpenLevelPack(); // so the level is planned from the same place the game will load it
+#endif
+    if ((level < 1) || (level > (int)levelCount) || !PlanSolution(level)) {
+      fprintf(stderr, "level %d can't be solved\n", level);
+      return EXIT_FAILURE;
+    }
+    // Planning loaded the level, so start the game from a blank screen, the way a recorded session does
+    levelDrawn = false;
+    memset(vram, 0, sizeof(vram));
+    tileWrites = 0; // only count the game's own
+    joypadSource = AutoPlay;
+  } else {
+    session = (optind < argc) ? fopen(argv[optind], "r") : stdin;
+    if (!session) {
+      perror(argv[optind]);
+      return EXIT_FAILURE;
+    }
+    joypadSource = ReadSession;
+  }
+
+  laser_main();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+/*
+
+  solve.c
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Runs the in-game solver over every level (or the levels given on the
+// command line) and prints, as CSV, how many solutions each one has, whether
+// the stored solution is the one that was found, whether the stored solution
+// lights every piece when the laser is traced through it, and how long it
+// took. Exits with an error unless every level has exactly its stored
+// solution, and it lights everything.
+//
+// With -p, the levels come from a level pack instead, the way the game
+// loads them from LASER.PAK. Packs have no stored solutions, so only the
+// number of solutions is checked, and it has to be exactly one.
+//
+// The levels are shared out between worker processes (-j sets how many, and
+// the default is one per CPU). Each one takes the next level nobody has
+// started on yet, so a slow level doesn't hold up the rest.
+//
+//   solve [-j workers] [-p pack] [level...]
+
+#define _DEFAULT_SOURCE
+
+#define main laser_main
+#include "../laser.c"
+#undef main
+
+#include "../data/solutions.inc"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Count this many solutions at most, which is plenty to tell unique levels apart
+#define SOLVE_LIMIT 1000
+
+// Whether the first solution found is the one stored in levelSolutions
+static bool MatchesStoredSolution(const uint8_t level)
+{
+  uint8_t solved[BOARD_MAX_H][BOARD_MAX_W];
+  memcpy(solved, board, sizeof(solved));
+  for (uint8_t i = 0; i < solutionPieces; ++i)
+    solved[solutionCell[i] / BOARD_MAX_W][solutionCell[i] % BOARD_MAX_W] = solutionPiece[i];
+
+  const uint16_t offset = (level - 1) * 25;
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x)
+      if ((solved[y][x] & 0x0F) != pgm_read_byte(&levelSolutions[offset + y * 5 + x]))
+	return false;
+  return true;
+}
+
+// Whether the stored solution, put on the board, lights every piece that isn't a blocker
+static bool StoredSolutionLit(const uint8_t level)
+{
+  const uint16_t offset = (level - 1) * 25;
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x)
+      board[y][x] = pgm_read_byte(&levelSolutions[offset + y * 5 + x]) | 0x80;
+  TraceLaser();
+  return AllPiecesLit();
+}
+
+struct Result {
+  uint16_t solutions;
+  bool matches;
+  bool lit;
+  double ms;
+};
+
+extern const char* sdFileName;
+
+static void CheckLevel(const uint16_t level, struct Result* const result)
+{
+  LoadLevel(level);
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  result->solutions = Solve(SOLVE_LIMIT);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  result->ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+
+  if (levelPack) // no stored solution to compare with
+    return;
+  result->matches = (result->solutions > 0) && MatchesStoredSolution(level);
+  result->lit = StoredSolutionLit(level);
+}
+
+int main(int argc, char* argv[])
+{
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  int option;
+  while ((option = getopt(argc, argv, "j:p:")) != -1)
+    switch (option) {
+    case 'j':
+      workers = strtol(optarg, NULL, 0);
+      break;
+    case 'p':
+      sdFileName = optarg;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-j workers] [-p pack] [level...]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  if (workers < 1)
+    workers = 1;
+
+  if (sdFileName) {
+    OpenLevelPack();
+    if (!levelPack) {
+      fprintf(stderr, "%s isn't a level pack\n", sdFileName);
+      return EXIT_FAILURE;
+    }
+  }
+
+  uint16_t* const levels = malloc(levelCount * sizeof(*levels));
+  unsigned count = 0;
+  for (int level = 1; level <= (int)levelCount; ++level) {
+    if (optind < argc) {
+      bool wanted = false;
+      for (int i = optind; i < argc; ++i)
+	if (atoi(argv[i]) == level)
+	  wanted = true;
+      if (!wanted)
+	continue;
+    }
+    levels[count++] = level;
+  }
+
+  // The workers share the index of the next level to check, and a place for each result
+  struct Shared {
+    unsigned next;
+    struct Result results[];
+  }* const shared = mmap(NULL, sizeof(struct Shared) + levelCount * sizeof(struct Result),
+			 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (!levels || (shared == MAP_FAILED)) {
+    perror("solve");
+    return EXIT_FAILURE;
+  }
+  shared->next = 0;
+
+  if ((unsigned long)workers > count)
+    workers = count ? count : 1;
+  for (long w = 0; w < workers; ++w)
+    if (fork() == 0) {
+      // The pack file's read position would be shared with the other workers, so each opens its own
+      if (levelPack)
+	OpenLevelPack();
+      for (;;) {
+	const unsigned i = __atomic_fetch_add(&shared->next, 1, __ATOMIC_RELAXED);
+	if (i >= count)
+	  _exit(EXIT_SUCCESS);
+	CheckLevel(levels[i], &shared->results[i]);
+      }
+    }
+  int workerStatus;
+  while (wait(&workerStatus) > 0)
+    if (!WIFEXITED(workerStatus) || (WEXITSTATUS(workerStatus) != EXIT_SUCCESS)) {
+      fprintf(stderr, "a worker failed\n");
+      return EXIT_FAILURE;
+    }
+
+  int status = EXIT_SUCCESS;
+  printf("level,solutions,matches_stored,stored_lit,ms\n");
+  for (unsigned i = 0; i < count; ++i) {
+    const struct Result* const result = &shared->results[i];
+    printf("%u,%u%s,%s,%s,%.3f\n", levels[i], result->solutions, (result->solutions == SOLVE_LIMIT) ? "+" : "",
+	   levelPack ? "-" : result->matches ? "yes" : "no", levelPack ? "-" : result->lit ? "yes" : "no", result->ms);
+    if ((result->solutions != 1) || (!levelPack && (!result->matches || !result->lit)))
+      status = EXIT_FAILURE;
+  }
+  return status;
+}
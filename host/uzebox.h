@@ -0,0 +1,154 @@
+/*
+
+  uzebox.h
+
+  Copyright 2016 Matthew T. Pandina. All rights reserved.
+
+  This file is part of Laser.
+
+  Laser is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Laser is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Laser.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// Headless stand-in for the parts of the Uzebox kernel API (video mode 3,
+// inline sound mixer, SNES joypad) that the game uses. The kernel options
+// come from the same -D flags as default/Makefile, and kernel.c supplies
+// the implementations.
+
+#ifndef HOST_UZEBOX_H
+#define HOST_UZEBOX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint8_t u8;
+typedef int8_t s8;
+typedef uint16_t u16;
+typedef int16_t s16;
+typedef uint32_t u32;
+typedef int32_t s32;
+
+// Video mode 3
+#define TILE_WIDTH 8
+#define TILE_HEIGHT 8
+#ifndef SCREEN_TILES_H
+#define SCREEN_TILES_H 30
+#endif
+#ifndef SCREEN_TILES_V
+#define SCREEN_TILES_V 28
+#endif
+#ifndef VRAM_TILES_H
+#define VRAM_TILES_H SCREEN_TILES_H
+#endif
+#ifndef VRAM_TILES_V
+#define VRAM_TILES_V SCREEN_TILES_V
+#endif
+#ifndef MAX_SPRITES
+#define MAX_SPRITES 32
+#endif
+#ifndef RAM_TILES_COUNT
+#define RAM_TILES_COUNT 0
+#endif
+#define VRAM_PTR_TYPE char
+#define OFF_SCREEN (SCREEN_TILES_H * TILE_WIDTH)
+
+#define SPRITE_FLIP_X 1
+#define SPRITE_FLIP_Y 2
+#define SPRITE_BANK0 (0 << 6)
+#define SPRITE_BANK1 (1 << 6)
+#define SPRITE_BANK2 (2 << 6)
+#define SPRITE_BANK3 (3 << 6)
+
+struct SpriteStruct {
+  u8 x;
+  u8 y;
+  u8 tileIndex;
+  u8 flags;
+};
+
+extern struct SpriteStruct sprites[MAX_SPRITES];
+extern u8 vram[VRAM_TILES_H * VRAM_TILES_V];
+
+void SetTileTable(const char* data);
+void SetSpritesTileBank(u8 bank, const char* tileData);
+void SetTile(char x, char y, unsigned int tileId);
+void DrawMap(u8 x, u8 y, const VRAM_PTR_TYPE* map);
+void MapSprite2(u8 startSprite, const char* map, u8 spriteFlags);
+void MoveSprite(u8 startSprite, u8 x, u8 y, u8 width, u8 height);
+void WaitVsync(int count);
+
+// SNES joypad
+#define BTN_B      (1 << 0)
+#define BTN_Y      (1 << 1)
+#define BTN_SELECT (1 << 2)
+#define BTN_START  (1 << 3)
+#define BTN_UP     (1 << 4)
+#define BTN_DOWN   (1 << 5)
+#define BTN_LEFT   (1 << 6)
+#define BTN_RIGHT  (1 << 7)
+#define BTN_A      (1 << 8)
+#define BTN_X      (1 << 9)
+#define BTN_SL     (1 << 10)
+#define BTN_SR     (1 << 11)
+
+unsigned int ReadJoypad(unsigned char joypadNo);
+
+// EEPROM blocks
+#define EEPROM_BLOCK_SIZE 32
+#define EEPROM_ERROR_INVALID_BLOCK   0x01
+#define EEPROM_ERROR_FULL            0x02
+#define EEPROM_ERROR_BLOCK_NOT_FOUND 0x03
+#define EEPROM_ERROR_NOT_FORMATTED   0x04
+
+struct EepromBlockStruct {
+  u16 id;
+  u8 data[30];
+};
+
+bool isEepromFormatted(void);
+void FormatEeprom(void);
+char EepromWriteBlock(struct EepromBlockStruct* block);
+char EepromReadBlock(unsigned int blockId, struct EepromBlockStruct* block);
+
+// Sound
+#define PC_ENV_SPEED     0
+#define PC_NOISE_PARAMS  1
+#define PC_WAVE          2
+#define PC_NOTE_UP       3
+#define PC_NOTE_DOWN     4
+#define PC_NOTE_CUT      5
+#define PC_NOTE_HOLD     6
+#define PC_ENV_VOL       7
+#define PC_PITCH         8
+#define PC_TREMOLO_LEVEL 9
+#define PC_TREMOLO_RATE  10
+#define PC_SLIDE         11
+#define PC_SLIDE_SPEED   12
+#define PC_LOOP_START    13
+#define PC_LOOP_END      14
+#define PATCH_END        0xff
+
+struct PatchStruct {
+  u8 type;
+  const char* pcmData;
+  const char* cmdStream;
+  u16 loopStart;
+  u16 loopEnd;
+};
+
+void InitMusicPlayer(const struct PatchStruct* patchPointersParam);
+void StartSong(const char* song);
+void TriggerNote(u8 channel, u8 patch, u8 note, u8 volume);
+
+#endif // HOST_UZEBOX_H
@@ -28,10 +28,19 @@
 #include <string.h>
 #include <avr/pgmspace.h>
 #include <uzebox.h>
+#if LEVEL_PACK
+#include <petitfatfs/pff.h>
+#endif
+#if FRAME_PROFILE && !defined(__AVR__)
+#include <time.h>
+#endif
 
 #include "data/tileset.inc"
 #include "data/sprites.inc"
 #include "data/instructions.inc"
+#ifndef LEVELS // host/packlevels makes levels_packed.inc, so it brings its own
+#include "data/levels_packed.inc"
+#endif
 #include "data/patches.inc"
 #include "data/midisong.h"
 
@@ -81,17 +90,22 @@ typedef struct {
 #define D_IN_L 64
 #define D_IN_R 128
 
-// The configuration of the playing board (with the laser off)
-uint8_t board[5][5] = {
-  {  0,  0,  0,  0,  0 },
-  {  0,  0,  0,  0,  0 },
-  {  0,  0,  0,  0,  0 },
-  {  0,  0,  0,  0,  0 },
-  {  0,  0,  0,  0,  0 },
-};
+// The side a beam comes into a square from, as the bit position of its D_IN_* bit, less 4
+#define DIR_T 0
+#define DIR_B 1
+#define DIR_L 2
+#define DIR_R 3
+
+// The largest board that fits on the screen. Each level sets its own size, up to this.
+#define BOARD_MAX_W 5
+#define BOARD_MAX_H 5
+
+uint8_t boardWidth = BOARD_MAX_W;
+uint8_t boardHeight = BOARD_MAX_H;
 
-// The bitmap of where the laser is, and which direction(s) it is travelling
-uint8_t laser[5][5] = {
+// The configuration of the playing board (with the laser off). Squares past the
+// edge of a smaller board are locked blockers, so nothing can be dropped there.
+uint8_t board[BOARD_MAX_H][BOARD_MAX_W] = {
   {  0,  0,  0,  0,  0 },
   {  0,  0,  0,  0,  0 },
   {  0,  0,  0,  0,  0 },
@@ -99,653 +113,49 @@ uint8_t laser[5][5] = {
   {  0,  0,  0,  0,  0 },
 };
 
+// Where the laser is: for each DIR_*, the squares the beam came into from that side, one
+// bit per square in row order, so square (x, y) is bit y * BOARD_MAX_W + x. A beam that
+// runs into a piece it can't get through still sets its bit there. Which way the beam
+// left a square is where it came into the next one, so LaserOut() works that out by
+// shifting the whole board.
+uint32_t laserIn[4];
+
+// The squares the beam got into, so they are lit
+uint32_t laserLit;
+
+// The squares the laser went through, as (y << 4) | x, so only they have to be redrawn
+uint8_t litCells[BOARD_MAX_W * BOARD_MAX_H];
+uint8_t litCount = 0;
+uint8_t laserShown = 0; // how many of them have been drawn
+
 // The pieces in your "hand" (that need to be placed on the board)
 uint8_t hand[5] = { 0, 0, 0, 0, 0 };
 
-const uint8_t levelData[] PROGMEM = {
-  // LEVEL 1
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, P_TARGET_T, 0, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, 0, P_MIRROR_BL, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, P_TARGET_T, 0, 0,
-  // Hand
-  P_MIRROR_TL, 0, 0, 0, 0,
-
-  // LEVEL 2
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_TARGET_L,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, P_TARGET_T, 0, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, 0, P_SPLIT_TLBR, 0, P_TARGET_L,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, P_TARGET_T, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, 0, 0, 0, 0,
-
-  // LEVEL 3
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_TARGET_R, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_TARGET_R, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 4
-  // Puzzle
-  0, P_TARGET_R, 0, P_BLOCKER, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, P_TARGET_R, P_MIRROR_BL, P_BLOCKER, 0,
-  0, 0, P_MIRROR_TL, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, 0, 0, 0,
-  
-  // LEVEL 5
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, P_BLOCKER, P_TARGET_B, 0, 0,
-  0, 0, 0, P_BLOCKER, 0,
-  P_BLOCKER, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  P_MIRROR_BL, P_BLOCKER, P_TARGET_B, 0, 0,
-  P_MIRROR_TR, 0, P_MIRROR_TL, P_BLOCKER, 0,
-  P_BLOCKER, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 6
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, P_BLOCKER, 0, 0, 0,
-  0, 0, P_BLOCKER, 0, 0,
-  0, 0, 0, 0, P_TARGET_T,
-  0, 0, 0, 0, 0,
-  // Solution
-  P_MIRROR_BR, 0, 0, 0, P_MIRROR_BL,
-  P_MIRROR_TL, P_BLOCKER, 0, 0, 0,
-  0, 0, P_BLOCKER, 0, 0,
-  0, 0, 0, 0, P_TARGET_T,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 7
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, P_SPLIT_TLBR, 0, 0, P_TARGET_L,
-  0, 0, 0, 0, 0,
-  0, P_TARGET_T, 0, 0, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, P_MIRROR_BL, 0, 0, 0,
-  0, P_SPLIT_TLBR, 0, 0, P_TARGET_L,
-  0, 0, 0, 0, 0,
-  0, P_TARGET_T, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, 0, 0, 0, 0,
-
-  // LEVEL 8
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, P_MIRROR_BL, 0, 0, 0,
-  P_BLOCKER, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  P_TARGET_T, 0, 0, 0, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, P_MIRROR_BL, 0, 0, 0,
-  P_BLOCKER, 0, 0, 0, 0,
-  P_MIRROR_BR, P_MIRROR_TL, 0, 0, 0,
-  P_TARGET_T, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 9
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_TARGET_L,
-  0, 0, 0, P_TARGET_T, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_MIRROR_BL, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_SPLIT_TLBR, P_TARGET_L,
-  0, 0, 0, P_TARGET_T, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 10
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_TARGET_B, 0,
-  0, 0, P_BLOCKER, 0, 0,
-  0, 0, 0, P_BLOCKER, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, 0, 0, P_TARGET_B, 0,
-  0, 0, P_BLOCKER, P_MIRROR_TR, P_MIRROR_TL,
-  0, 0, 0, P_BLOCKER, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 11
-  // Puzzle
-  0, 0, 0, 0, P_TARGET_B,
-  0, 0, 0, P_MIRROR_BL, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_BLOCKER,
-  0, 0, 0, P_TARGET_T, 0,
-  // Solution
-  0, 0, 0, 0, P_TARGET_B,
-  0, 0, 0, P_MIRROR_BL, 0,
-  0, 0, 0, P_SPLIT_TLBR, P_MIRROR_TL,
-  0, 0, 0, 0, P_BLOCKER,
-  0, 0, 0, P_TARGET_T, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 12
-  // Puzzle
-  0, 0, P_TARGET_R, 0, 0,
-  0, 0, 0, P_MIRROR_BL, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, 0, P_TARGET_R, 0, P_MIRROR_BL,
-  0, 0, 0, P_MIRROR_BL, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_MIRROR_TR, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 13
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, P_BLOCKER, 0, 0, 0,
-  0, 0, P_TARGET_L, 0, 0,
-  P_BLOCKER, 0, P_TARGET_L, 0, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  P_MIRROR_BL, 0, 0, 0, 0,
-  0, P_BLOCKER, 0, 0, 0,
-  P_MIRROR_TR, P_SPLIT_TLBR, P_TARGET_L, 0, 0,
-  P_BLOCKER, P_MIRROR_TR, P_TARGET_L, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 14
-  // Puzzle
-  P_TARGET_R, 0, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_TL,
-  0, 0, P_BLOCKER, 0, P_TARGET_B,
-  0, P_BLOCKER, 0, P_BLOCKER, 0,
-  0, 0, 0, 0, P_MIRROR_TL,
-  // Solution
-  P_TARGET_R, 0, 0, 0, P_MIRROR_BL,
-  P_SPLIT_TLBR, 0, 0, 0, P_MIRROR_TL,
-  0, 0, P_BLOCKER, 0, P_TARGET_B,
-  0, P_BLOCKER, 0, P_BLOCKER, 0,
-  P_MIRROR_TR, 0, 0, 0, P_MIRROR_TL,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 15
-  // Puzzle
-  0, 0, 0, P_TARGET_B, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, P_TARGET_T, 0, 0, 0,
-  // Solution
-  0, 0, 0, P_TARGET_B, 0,
-  0, P_SPLIT_TLBR, 0, P_MIRROR_TL, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, P_TARGET_T, 0, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 16
-  // Puzzle
-  0, 0, 0, P_TARGET_R, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, P_TARGET_T, 0, 0, 0,
-  // Solution
-  0, 0, 0, P_TARGET_R, P_MIRROR_BL,
-  0, P_SPLIT_TLBR, 0, 0, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, P_TARGET_T, 0, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 17
-  // Puzzle
-  0, 0, 0, 0, 0,
-  P_SPLIT_TLBR, P_MIRROR_BL, 0, 0, 0,
-  0, 0, P_MIRROR_BL, 0, 0,
-  P_BLOCKER, 0, 0, P_TARGET_L, 0,
-  0, 0, P_TARGET_T, 0, 0,
-  // Solution
-  0, 0, 0, 0, 0,
-  P_SPLIT_TLBR, P_MIRROR_BL, 0, 0, 0,
-  P_MIRROR_TR, 0, P_MIRROR_BL, 0, 0,
-  P_BLOCKER, P_MIRROR_TR, 0, P_TARGET_L, 0,
-  0, 0, P_TARGET_T, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 18
-  // Puzzle
-  P_BLOCKER, 0, 0, 0, P_MIRROR_BL,
-  0, P_BLOCKER, P_TARGET_T, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_BLOCKER,
-  0, 0, 0, 0, 0,
-  // Solution
-  P_BLOCKER, 0, P_MIRROR_BR, 0, P_MIRROR_BL,
-  P_MIRROR_BL, P_BLOCKER, P_TARGET_T, 0, 0,
-  P_MIRROR_TR, 0, 0, 0, P_MIRROR_TL,
-  0, 0, 0, 0, P_BLOCKER,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 19
-  // Puzzle
-  0, P_TARGET_B, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, 0, 0, 0, 0,
-  0, P_BLOCKER, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, P_TARGET_B, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, P_MIRROR_TR, 0, 0, P_MIRROR_TL,
-  0, P_BLOCKER, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 20
-  // Puzzle
-  0, 0, 0, P_TARGET_B, 0,
-  0, 0, 0, 0, 0,
-  P_TARGET_R, 0, 0, P_SPLIT_TLBR, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, 0, 0, P_TARGET_B, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  P_TARGET_R, 0, 0, P_SPLIT_TLBR, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 21
-  // Puzzle
-  0, 0, P_MIRROR_BR, 0, 0,
-  0, 0, 0, 0, P_MIRROR_TL,
-  P_TARGET_B, 0, 0, 0, 0,
-  0, P_BLOCKER, 0, 0, P_TARGET_L,
-  0, 0, P_MIRROR_TL, 0, 0,
-  // Solution
-  0, 0, P_MIRROR_BR, 0, P_MIRROR_BL,
-  0, 0, 0, 0, P_MIRROR_TL,
-  P_TARGET_B, 0, 0, 0, 0,
-  0, P_BLOCKER, P_SPLIT_TLBR, 0, P_TARGET_L,
-  P_MIRROR_TR, 0, P_MIRROR_TL, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 22
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_BLOCKER,
-  0, P_MIRROR_TR, 0, 0, 0,
-  P_TARGET_R, 0, 0, 0, 0,
-  0, 0, 0, 0, P_TARGET_T,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, P_MIRROR_BL, 0, 0, P_BLOCKER,
-  0, P_MIRROR_TR, 0, 0, P_MIRROR_BL,
-  P_TARGET_R, 0, 0, 0, P_SPLIT_TRBL,
-  0, 0, 0, 0, P_TARGET_T,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 23
-  // Puzzle
-  0, P_MIRROR_BL, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  P_TARGET_T, 0, 0, 0, 0,
-  0, P_TARGET_R, 0, 0, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Solution
-  P_MIRROR_BR, P_MIRROR_BL, 0, 0, 0,
-  0, P_SPLIT_TRBL, 0, 0, P_MIRROR_BL,
-  P_TARGET_T, 0, 0, 0, 0,
-  0, P_TARGET_R, 0, 0, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, 0, 0, 0,
-
-  // LEVEL 24
-  // Puzzle
-  0, 0, 0, P_TARGET_B, 0,
-  0, 0, 0, 0, 0,
-  0, 0, P_BLOCKER, 0, 0,
-  0, 0, 0, P_TARGET_T, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, 0, 0, P_TARGET_B, 0,
-  0, 0, 0, P_SPLIT_TRBL, P_MIRROR_BL,
-  0, 0, P_BLOCKER, P_MIRROR_BR, P_MIRROR_TL,
-  0, 0, 0, P_TARGET_T, 0,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 25
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, P_BLOCKER, 0, 0,
-  P_TARGET_R, 0, 0, 0, 0,
-  0, P_BLOCKER, 0, 0, P_TARGET_L,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_MIRROR_BL, 0,
-  0, 0, P_BLOCKER, 0, 0,
-  P_TARGET_R, 0, 0, P_SPLIT_TRBL, 0,
-  0, P_BLOCKER, 0, P_MIRROR_TR, P_TARGET_L,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 26
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  P_BLOCKER, 0, P_SPLIT_TLBR, 0, 0,
-  0, 0, 0, P_TARGET_L, P_TARGET_T,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, P_MIRROR_BL, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  P_BLOCKER, P_MIRROR_TR, P_SPLIT_TLBR, 0, P_MIRROR_BL,
-  0, 0, P_MIRROR_TR, P_TARGET_L, P_TARGET_T,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 27
-  // Puzzle
-  P_TARGET_B, 0, P_MIRROR_BR, 0, P_BLOCKER,
-  0, 0, 0, 0, 0,
-  0, 0, P_BLOCKER, 0, P_TARGET_T,
-  P_MIRROR_TR, 0, 0, P_MIRROR_TL, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  P_TARGET_B, 0, P_MIRROR_BR, P_MIRROR_BL, P_BLOCKER,
-  0, 0, P_SPLIT_TRBL, 0, P_MIRROR_BL,
-  0, 0, P_BLOCKER, 0, P_TARGET_T,
-  P_MIRROR_TR, 0, 0, P_MIRROR_TL, 0,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 28
-  // Puzzle
-  P_MIRROR_BR, 0, 0, P_BLOCKER, 0,
-  0, 0, P_BLOCKER, 0, 0,
-  P_BLOCKER, 0, 0, 0, 0,
-  0, 0, 0, P_SPLIT_TLBR, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  P_MIRROR_BR, P_MIRROR_BL, 0, P_BLOCKER, 0,
-  P_MIRROR_TL, 0, P_BLOCKER, 0, 0,
-  P_BLOCKER, 0, 0, 0, 0,
-  0, P_MIRROR_TR, 0, P_SPLIT_TLBR, P_TARGET_L,
-  0, 0, 0, P_TARGET_T, 0,
-  // Hand
-  P_TARGET_L, P_TARGET_L, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL,
-
-  // LEVEL 29
-  // Puzzle
-  P_TARGET_R, 0, 0, P_MIRROR_BL, 0,
-  0, 0, P_TARGET_R, 0, 0,
-  0, 0, 0, P_BLOCKER, 0,
-  0, P_MIRROR_TR, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  P_TARGET_R, 0, 0, P_MIRROR_BL, 0,
-  0, P_MIRROR_BL, P_TARGET_R, P_SPLIT_TLBR, P_MIRROR_BL,
-  0, 0, 0, P_BLOCKER, 0,
-  0, P_MIRROR_TR, 0, 0, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 30
-  // Puzzle
-  P_BLOCKER, 0, 0, 0, 0,
-  0, 0, P_TARGET_R, 0, 0,
-  0, P_BLOCKER, 0, 0, 0,
-  0, 0, 0, 0, P_BLOCKER,
-  0, 0, P_TARGET_R, 0, 0,
-  // Solution
-  P_BLOCKER, P_MIRROR_BR, 0, P_MIRROR_BL, 0,
-  0, P_MIRROR_TL, P_TARGET_R, P_SPLIT_TRBL, 0,
-  0, P_BLOCKER, 0, 0, 0,
-  0, 0, 0, 0, P_BLOCKER,
-  0, 0, P_TARGET_R, P_MIRROR_TL, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL,
-
-  // LEVEL 31
-  // Puzzle
-  P_MIRROR_BR, 0, 0, P_BLOCKER, 0,
-  0, 0, P_BLOCKER, 0, 0,
-  0, P_BLOCKER, 0, 0, 0,
-  0, 0, 0, P_SPLIT_TLBR, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  P_MIRROR_BR, P_MIRROR_BL, 0, P_BLOCKER, 0,
-  0, P_MIRROR_TL, P_BLOCKER, 0, 0,
-  0, P_BLOCKER, 0, 0, 0,
-  P_MIRROR_TR, 0, 0, P_SPLIT_TLBR, P_TARGET_L,
-  0, 0, 0, P_TARGET_T, 0,
-  // Hand
-  P_TARGET_L, P_TARGET_L, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL,
-
-  // LEVEL 32
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  P_TARGET_B, P_TARGET_R, 0, P_BLOCKER, 0,
-  0, 0, 0, P_BLOCKER, 0,
-  0, P_BLOCKER, 0, 0, P_MIRROR_TL,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  P_TARGET_B, P_TARGET_R, P_MIRROR_BL, P_BLOCKER, 0,
-  P_MIRROR_TR, 0, P_SPLIT_TLBR, P_BLOCKER, 0,
-  0, P_BLOCKER, P_MIRROR_TR, 0, P_MIRROR_TL,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL,
-
-  // LEVEL 33
-  // Puzzle
-  0, P_TARGET_B, P_TARGET_B, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, 0, 0, 0, 0,
-  0, 0, P_SPLIT_TLBR, 0, P_BLOCKER,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, P_TARGET_B, P_TARGET_B, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, 0, 0, P_MIRROR_BR, P_MIRROR_TL,
-  0, P_MIRROR_TR, P_SPLIT_TLBR, P_MIRROR_TL, P_BLOCKER,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 34
-  // Puzzle
-  0, 0, P_MIRROR_BL, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, 0, P_TARGET_L,
-  P_TARGET_R, 0, P_BLOCKER, 0, 0,
-  // Solution
-  0, P_MIRROR_BR, P_MIRROR_BL, 0, 0,
-  0, 0, P_MIRROR_TL, 0, 0,
-  0, 0, 0, 0, 0,
-  0, P_SPLIT_TLBR, 0, 0, P_TARGET_L,
-  P_TARGET_R, P_MIRROR_TL, P_BLOCKER, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 35
-  // Puzzle
-  0, P_TARGET_B, P_TARGET_B, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, 0, 0, 0, 0,
-  0, 0, P_SPLIT_TRBL, 0, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, P_TARGET_B, P_TARGET_B, 0, 0,
-  P_MIRROR_BL, P_MIRROR_TR, 0, 0, P_MIRROR_BL,
-  0, 0, 0, 0, 0,
-  P_MIRROR_TR, 0, P_SPLIT_TRBL, 0, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 36
-  // Puzzle
-  0, P_TARGET_R, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, 0, 0, P_BLOCKER, 0,
-  0, P_TARGET_R, 0, 0, P_MIRROR_TL,
-  0, 0, P_MIRROR_TR, 0, 0,
-  // Solution
-  0, P_TARGET_R, P_MIRROR_BL, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  0, 0, 0, P_BLOCKER, 0,
-  0, P_TARGET_R, 0, P_SPLIT_TRBL, P_MIRROR_TL,
-  0, 0, P_MIRROR_TR, P_MIRROR_TL, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, 0, 0,
-
-  // LEVEL 37
-  // Puzzle
-  0, P_TARGET_B, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  P_TARGET_R, 0, 0, 0, 0,
-  0, 0, 0, P_SPLIT_TLBR, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, P_TARGET_B, 0, 0, 0,
-  0, 0, 0, 0, P_MIRROR_BL,
-  P_TARGET_R, 0, 0, P_MIRROR_BL, 0,
-  0, P_MIRROR_TR, 0, P_SPLIT_TLBR, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 38
-  // Puzzle
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_BLOCKER, 0,
-  P_TARGET_B, P_TARGET_R, 0, 0, 0,
-  0, 0, 0, P_BLOCKER, 0,
-  0, P_BLOCKER, 0, 0, P_MIRROR_TL,
-  // Solution
-  0, 0, 0, 0, 0,
-  0, 0, P_MIRROR_BL, P_BLOCKER, 0,
-  P_TARGET_B, P_TARGET_R, 0, 0, P_MIRROR_BL,
-  P_MIRROR_TR, 0, P_SPLIT_TRBL, P_BLOCKER, 0,
-  0, P_BLOCKER, P_MIRROR_TR, 0, P_MIRROR_TL,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL,
-
-  // LEVEL 39
-  // Puzzle
-  P_MIRROR_BR, 0, 0, 0, 0,
-  0, 0, 0, 0, 0,
-  0, 0, 0, P_TARGET_R, 0,
-  0, 0, 0, 0, 0,
-  0, 0, P_MIRROR_TL, 0, P_TARGET_T,
-  // Solution
-  P_MIRROR_BR, 0, 0, 0, P_MIRROR_BL,
-  0, 0, P_MIRROR_BL, 0, 0,
-  0, 0, 0, P_TARGET_R, P_SPLIT_TRBL,
-  0, 0, 0, 0, 0,
-  P_MIRROR_TR, 0, P_MIRROR_TL, 0, P_TARGET_T,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, 0,
-
-  // LEVEL 40
-  // Puzzle
-  0, P_TARGET_R, 0, 0, 0,
-  0, 0, 0, P_BLOCKER, 0,
-  0, P_TARGET_R, 0, 0, 0,
-  0, 0, P_MIRROR_TR, 0, 0,
-  0, 0, 0, 0, 0,
-  // Solution
-  0, P_TARGET_R, 0, 0, P_MIRROR_BL,
-  0, 0, P_MIRROR_BL, P_BLOCKER, 0,
-  0, P_TARGET_R, 0, P_MIRROR_BL, 0,
-  0, 0, P_MIRROR_TR, P_SPLIT_TRBL, P_MIRROR_TL,
-  0, 0, 0, 0, 0,
-  // Hand
-  P_SPLIT_TRBL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL, P_MIRROR_TL,
-};
+// The number of moves the player has made on this level: putting a piece
+// down somewhere new, or rotating one on the board
+uint8_t moves = 0;
 
-#define LEVEL_SIZE 55
-#define LEVELS (sizeof(levelData) / LEVEL_SIZE)
+static void CountMove(void)
+{
+  if (moves != 255)
+    ++moves;
+}
+
+/* The moves made on this level, so they can be undone and redone. Each
+   entry is 0b0000 TTtt tttf ffff: a piece was taken from square f,
+   turned clockwise T times, and put down on square t. Squares are
+   y * BOARD_MAX_W + x on the board, or JOURNAL_HAND + i for the hand, and
+   rotating a piece where it is has f == t. The oldest entries are
+   overwritten when it fills up.
+*/
+#define JOURNAL_SIZE 32 // a power of 2
+#define JOURNAL_HAND (BOARD_MAX_W * BOARD_MAX_H)
+#define JOURNAL_ENTRY(from, to, turns) ((from) | ((uint16_t)(to) << 5) | ((uint16_t)(turns) << 10))
+
+uint16_t journal[JOURNAL_SIZE];
+uint8_t journalHead = 0; // where the next move goes, and just past the last one to undo
+uint8_t journalUndo = 0; // how many moves there are to undo
+uint8_t journalRedo = 0; // and to redo
 
 const VRAM_PTR_TYPE* MapName(uint8_t piece)
 {
@@ -819,7 +229,7 @@ static bool BCD_addConstant(uint8_t* const num, const uint8_t digits, uint8_t x)
       num[i] = val - 30;
       x = 3;
     } else { // handle the rest of the cases (up to 255 - 9) with a loop
-      for (uint8_t j = 5; j < 26; ++j) {
+      for (uint8_t j = 5; j < 27; ++j) {
         if (val < (j * 10)) {
           num[i] = val - ((j - 1) * 10);
           x = (j - 1);
@@ -845,42 +255,317 @@ static bool BCD_addConstant(uint8_t* const num, const uint8_t digits, uint8_t x)
 // and the 9 highest below that are reserved for drag-and-drop
 #define RESERVED_SPRITES 10
 
-static void LoadLevel(const uint8_t level, bool solution)
+/* Frame profiling
+
+   Built with FRAME_PROFILE=1, the parts of the main loop are timed, and the
+   top left of the screen shows how many scanlines the last frame took,
+   followed by the most any frame has taken. The time each part took in the
+   last frame is kept in profileLast[], and the most it has ever taken in
+   profileWorst[], so the host tools can dump them.
+
+   Timer1 belongs to the video kernel, so on the AVR, Timer0 is used. It
+   counts every 1024 cycles, and has no interrupt, so it can't upset the
+   video timing, but one part can only be timed up to 262144 cycles. On
+   the host, the times are in nanoseconds.
+*/
+#if FRAME_PROFILE
+enum { PROFILE_INPUT, PROFILE_TRACE, PROFILE_DRAW, PROFILE_ERASE, PROFILE_DRAG, PROFILE_ROTATE, PROFILE_LOAD,
+       PROFILE_HINT, PROFILE_PARTS };
+
+#define PROFILE_DIGITS 3
+#define PROFILE_SPRITES (2 * PROFILE_DIGITS) // the sprites below the reserved ones
+#define LINE_CYCLES 1820
+
+uint32_t profileLast[PROFILE_PARTS];
+uint32_t profileWorst[PROFILE_PARTS];
+uint32_t profileFrameWorst = 0; // the most all of the parts have taken in one frame
+static uint32_t profileFrame[PROFILE_PARTS]; // the frame being timed
+static uint32_t profileStart;
+
+#if defined(__AVR__)
+#define PROFILE_PRESCALE_SHIFT 10
+#define PROFILE_MASK ((256UL << PROFILE_PRESCALE_SHIFT) - 1)
+
+static void InitProfile(void)
+{
+  TCCR0A = 0;
+  TCCR0B = _BV(CS02) | _BV(CS00); // clk/1024
+}
+
+static uint32_t ProfileTime(void)
+{
+  return (uint32_t)TCNT0 << PROFILE_PRESCALE_SHIFT;
+}
+
+static uint32_t ProfileLines(const uint32_t cycles)
+{
+  return cycles / LINE_CYCLES;
+}
+#else
+#define PROFILE_MASK 0xFFFFFFFFUL
+
+static void InitProfile(void)
+{
+}
+
+static uint32_t ProfileTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static uint32_t ProfileLines(const uint32_t ns)
+{
+  return ns / 63556; // the length of a scanline, to the nearest nanosecond
+}
+#endif
+
+#define PROFILE_BEGIN() (profileStart = ProfileTime())
+#define PROFILE_END(part) (profileFrame[part] += (ProfileTime() - profileStart) & PROFILE_MASK)
+
+static void ShowProfileNumber(uint8_t sprite, const uint8_t x, uint32_t value)
+{
+  uint8_t digits[PROFILE_DIGITS] = {0};
+  if (value > 999)
+    value = 999;
+  for (uint16_t n = value; n; ) {
+    const uint8_t add = (n > BCD_ADD_CONSTANT_MAX) ? BCD_ADD_CONSTANT_MAX : n;
+    BCD_addConstant(digits, PROFILE_DIGITS, add);
+    n -= add;
+  }
+  for (uint8_t i = 0; i < PROFILE_DIGITS; ++i, ++sprite) {
+    sprites[sprite].tileIndex = digits[i] + FIRST_DIGIT_SPRITE;
+    sprites[sprite].flags = 0;
+    sprites[sprite].x = (x + PROFILE_DIGITS - 1 - i) * TILE_WIDTH;
+    sprites[sprite].y = 0;
+  }
+}
+
+// Called once a frame, to finish timing the last one and start on the next
+static void ProfileFrame(void)
+{
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < PROFILE_PARTS; ++i) {
+    profileLast[i] = profileFrame[i];
+    if (profileFrame[i] > profileWorst[i])
+      profileWorst[i] = profileFrame[i];
+    total += profileFrame[i];
+    profileFrame[i] = 0;
+  }
+  if (total > profileFrameWorst)
+    profileFrameWorst = total;
+
+  const uint8_t first = MAX_SPRITES - RESERVED_SPRITES - PROFILE_SPRITES;
+  ShowProfileNumber(first, 0, ProfileLines(total));
+  ShowProfileNumber(first + PROFILE_DIGITS, PROFILE_DIGITS + 1, ProfileLines(profileFrameWorst));
+}
+
+#define PROFILE_INIT() InitProfile()
+#define PROFILE_FRAME() ProfileFrame()
+#else
+#define PROFILE_SPRITES 0
+#define PROFILE_INIT()
+#define PROFILE_FRAME()
+#define PROFILE_BEGIN()
+#define PROFILE_END(part)
+#endif
+
+/* Each level in levelData is packed into a header byte, a size byte, then the board, then the hand
+
+   header: 0b HHHB BBBB
+     H = the number of pieces in the hand (0-5)
+     B = the number of board bytes that follow (0-25)
+
+   size: 0b WWWW HHHH
+     W = the width of the board (1-BOARD_MAX_W)
+     H = the height of the board (2-BOARD_MAX_H, since the laser comes in on the second row)
+
+   board: 0b SSSS PPPP (one byte per piece, in row order)
+     S = the number of blank squares to skip
+     P = the piece that comes after them (P_BLANK just skips one more square)
+     Any squares after the last board byte are blank
+
+   hand: two pieces per byte, high nibble first
+*/
+#define LEVEL_BOARD_BYTES(header) ((header) & 0x1F)
+#define LEVEL_HAND_PIECES(header) ((header) >> 5)
+#define LEVEL_BYTES(header) (2 + LEVEL_BOARD_BYTES(header) + (LEVEL_HAND_PIECES(header) + 1) / 2)
+
+// Levels are different sizes, so find where this one starts by skipping over the ones before it
+static const uint8_t* LevelAddress(uint8_t level)
+{
+  const uint8_t* data = levelData;
+  while (--level)
+    data += LEVEL_BYTES(pgm_read_byte(data));
+  return data;
+}
+
+/* Level packs
+
+   More levels can be put in a file on the SD card, LEVEL_PACK_FILE, and
+   played instead of the ones in flash, without reflashing. The file is made
+   of LEVEL_RECORD_BYTES records: a header, then one record per level, so
+   level n is record n.
+
+   header: 'L' 'P' 'A' 'K', the record size (LEVEL_RECORD_BYTES), 0, then
+     the number of levels (low byte first), then zeros
+
+   level: the level, packed the same way as in levelData, then zeros
+
+   Since the records are all the same size, a level is found with a single
+   seek, and since they divide a 512 byte sector evenly, reading one never
+   spans two sectors. Only the level being loaded is ever kept in RAM.
+*/
+#define LEVEL_RECORD_BYTES 32 // a level takes at most 2 + 25 + 3 bytes
+#define LEVEL_PACK_HEADER_BYTES 8 // the part of the header record that isn't zeros
+#define LEVEL_PACK_FILE "LASER.PAK"
+#define LEVEL_PACK_MAX_LEVELS 9999 // as many as there are digits to show the level number
+#define LEVEL_DIGITS 4
+
+uint8_t levelRecord[LEVEL_RECORD_BYTES]; // the level being loaded
+uint16_t levelCount = LEVELS;
+
+#if LEVEL_PACK
+static FATFS levelPackFs;
+bool levelPack = false; // whether the levels come from the SD card
+
+// Switches to the levels on the SD card, if there is a card with a level pack on it
+static void OpenLevelPack(void)
+{
+  uint8_t header[LEVEL_PACK_HEADER_BYTES];
+  UINT got;
+
+  if ((pf_mount(&levelPackFs) != FR_OK) || (pf_open(LEVEL_PACK_FILE) != FR_OK) ||
+      (pf_read(header, sizeof(header), &got) != FR_OK) || (got != sizeof(header)))
+    return;
+  if ((header[0] != 'L') || (header[1] != 'P') || (header[2] != 'A') || (header[3] != 'K') ||
+      (header[4] != LEVEL_RECORD_BYTES))
+    return;
+  const uint16_t count = header[6] | (header[7] << 8);
+  if (count == 0)
+    return;
+  levelCount = (count > LEVEL_PACK_MAX_LEVELS) ? LEVEL_PACK_MAX_LEVELS : count;
+  levelPack = true;
+}
+
+// Whether the level in levelRecord can be loaded without reading past the end of it
+static bool LevelRecordValid(void)
+{
+  const uint8_t header = levelRecord[0];
+  const uint8_t width = levelRecord[1] >> 4;
+  const uint8_t height = levelRecord[1] & 0x0F;
+  return (LEVEL_BOARD_BYTES(header) <= BOARD_MAX_W * BOARD_MAX_H) && (LEVEL_HAND_PIECES(header) <= 5) &&
+    (width >= 1) && (width <= BOARD_MAX_W) && (height >= 2) && (height <= BOARD_MAX_H);
+}
+#else
+#define levelPack false
+#endif
+
+// Copies a level into levelRecord, from the level pack if there is one, or else from flash
+static void ReadLevel(const uint16_t level)
+{
+#if LEVEL_PACK
+  if (levelPack) {
+    UINT got;
+    if ((pf_lseek((DWORD)level * LEVEL_RECORD_BYTES) != FR_OK) ||
+	(pf_read(levelRecord, LEVEL_RECORD_BYTES, &got) != FR_OK) || (got != LEVEL_RECORD_BYTES) ||
+	!LevelRecordValid()) {
+      memset(levelRecord, 0, LEVEL_RECORD_BYTES); // an empty board is better than garbage
+      levelRecord[1] = (BOARD_MAX_W << 4) | BOARD_MAX_H;
+    }
+    return;
+  }
+#endif
+  const uint8_t* const data = LevelAddress(level);
+  memcpy_P(levelRecord, data, LEVEL_BYTES(pgm_read_byte(data)));
+}
+
+// Whether a level is on the screen. If it is, board[] and hand[] match what
+// is drawn there (with the laser off), so the next level only has to redraw
+// the squares that are different.
+bool levelDrawn = false;
+
+static void LoadLevel(const uint16_t level)
 {
   for (uint8_t i = 0; i < MAX_SPRITES - 1; ++i)
     sprites[i].x = OFF_SCREEN;
-  
-  for (uint8_t v = 0; v < VRAM_TILES_V; ++v)
-    for (uint8_t h = 0; h < VRAM_TILES_H; ++h)
-      SetTile(h, v, TILE_BACKGROUND);
-
-  DrawMap(0, 1, map_graphic);
-  DrawMap(9, 22, map_move_to_grid);
+  litCount = laserShown = 0; // none of the new level's squares are lit
+  moves = 0;
+  journalUndo = journalRedo = 0;
+
+  // The chrome around the board only has to be drawn the first time
+  if (!levelDrawn) {
+    for (uint8_t v = 0; v < VRAM_TILES_V; ++v)
+      for (uint8_t h = 0; h < VRAM_TILES_H; ++h)
+	SetTile(h, v, TILE_BACKGROUND);
+
+    DrawMap(0, 1, map_graphic);
+    DrawMap(9, 22, map_move_to_grid);
+  }
 
-  DrawMap(PREV_NEXT_X, PREV_NEXT_Y, map_prev_next);
-  
-  uint8_t levelDisplay[2] = {0};
-  BCD_addConstant(levelDisplay, 2, level);
-  // Since we ran out of unique background tile indices, we have to resort to using sprites
-  sprites[0].tileIndex = levelDisplay[0] + FIRST_DIGIT_SPRITE;
-  sprites[1].tileIndex = levelDisplay[1] + FIRST_DIGIT_SPRITE;
+  DrawMap(PREV_NEXT_X, PREV_NEXT_Y, map_prev_next); // in case the next button was flashing
   
-  sprites[0].y = 23 * TILE_HEIGHT + TILE_HEIGHT / 2; // This uses an extra RAM tile
-  sprites[1].y = 23 * TILE_HEIGHT + TILE_HEIGHT / 2; // but makes it look better
-  sprites[0].x = (PREV_NEXT_X + 2) * TILE_WIDTH;
-  sprites[1].x = (PREV_NEXT_X + 1) * TILE_WIDTH;
+  // Since we ran out of unique background tile indices, we have to resort to using sprites.
+  // The last two digits are sprites 0 and 1, and any more come after the thumb (sprite 2).
+  const uint8_t digits = (levelCount > 999) ? 4 : (levelCount > 99) ? 3 : 2;
+  uint8_t levelDisplay[LEVEL_DIGITS] = {0};
+  for (uint16_t n = level; n; ) {
+    const uint8_t add = (n > BCD_ADD_CONSTANT_MAX) ? BCD_ADD_CONSTANT_MAX : n;
+    BCD_addConstant(levelDisplay, LEVEL_DIGITS, add);
+    n -= add;
+  }
+  for (uint8_t i = 0; i < digits; ++i) {
+    const uint8_t sprite = (i < 2) ? i : i + 1;
+    sprites[sprite].tileIndex = levelDisplay[i] + FIRST_DIGIT_SPRITE;
+    sprites[sprite].y = 23 * TILE_HEIGHT + TILE_HEIGHT / 2; // This uses an extra RAM tile, but makes it look better
+    sprites[sprite].x = (PREV_NEXT_X + 2 - i) * TILE_WIDTH;
+  }
 	
-  const uint16_t levelOffset = (level - 1) * LEVEL_SIZE;
-  uint8_t currentSprite = 3;
+  ReadLevel(level);
+  const uint8_t* data = levelRecord;
+  const uint8_t header = *data++;
+  const uint8_t size = *data++;
+  const uint8_t oldWidth = boardWidth;
+  const uint8_t oldHeight = boardHeight;
+  boardWidth = size >> 4;
+  boardHeight = size & 0x0F;
+  uint8_t boardBytes = LEVEL_BOARD_BYTES(header);
+  uint8_t run = 0; // the board byte being decoded
+  bool running = false;
+  uint8_t currentSprite = digits + 1; // the first one after the level number
   
-  for (uint8_t y = 0; y < 5; ++y)
-    for (uint8_t x = 0; x < 5; ++x) {
-      uint8_t piece = (uint8_t)pgm_read_byte(&levelData[(levelOffset + (solution ? 25 : 0)) + y * 5 + x]);
+  for (uint8_t y = 0; y < BOARD_MAX_H; ++y)
+    for (uint8_t x = 0; x < BOARD_MAX_W; ++x) {
+      // Only squares that were drawn for the last level, with something else there, need drawing again
+      const bool drawn = levelDrawn && (x < oldWidth) && (y < oldHeight);
+      if ((x >= boardWidth) || (y >= boardHeight)) {
+	if (drawn) // the board got smaller
+	  for (uint8_t v = 0; v < 3; ++v)
+	    for (uint8_t h = 0; h < 3; ++h)
+	      SetTile(9 + x * 4 + h, 1 + y * 4 + v, TILE_BACKGROUND);
+	board[y][x] = P_BLOCKER | 0x80;
+	continue;
+      }
+      uint8_t piece = P_BLANK;
+      if (!running && boardBytes) {
+	run = *data++;
+	--boardBytes;
+	running = true;
+      }
+      if (running) {
+	if (run >= 0x10) { // count down the blank squares before the piece
+	  run -= 0x10;
+	} else {
+	  piece = run;
+	  running = false;
+	}
+      }
+      if (!drawn || ((board[y][x] & 0x0F) != piece))
+	DrawMap(9 + x * 4, 1 + y * 4, MapName(piece));
       board[y][x] = piece | 0x80; // set the high bit, to denote a piece that cannot be moved
-      DrawMap(9 + x * 4, 1 + y * 4, MapName(piece));
       // Any pieces that are part of the inital setup can't be moved, so add a lock icon
-      if ((piece != P_BLANK) && (currentSprite < (MAX_SPRITES - RESERVED_SPRITES))
-	  && (solution == false)) {
+      if ((piece != P_BLANK) && (currentSprite < (MAX_SPRITES - RESERVED_SPRITES - PROFILE_SPRITES))) {
       	sprites[currentSprite].tileIndex = 0;
       	sprites[currentSprite].x = (11 + x * 4) * TILE_WIDTH;
       	sprites[currentSprite].y = (3 + y * 4) * TILE_HEIGHT;
@@ -888,395 +573,683 @@ static void LoadLevel(const uint8_t level, bool solution)
       }
     }
   
-  if (solution) {
-    for (uint8_t x = 0; x < 5; ++x)
-      DrawMap(9 + x * 4, 23, map_blank);
-    return;
-  }
-    
   for (uint8_t x = 0; x < 5; ++x) {
-    uint8_t piece = (uint8_t)pgm_read_byte(&levelData[(levelOffset + 50) + x]);
+    uint8_t piece = P_BLANK;
+    if (x < LEVEL_HAND_PIECES(header)) {
+      piece = data[x / 2];
+      piece = (x & 1) ? (piece & 0x0F) : (piece >> 4);
+    }
+    if (!levelDrawn || (hand[x] != piece))
+      DrawMap(9 + x * 4, 23, MapName(piece));
     hand[x] = piece;
-    DrawMap(9 + x * 4, 23, MapName(piece));
   }
+  levelDrawn = true;
 }
 
-void SimulatePhoton(void)
+/* The player's progress is kept in EEPROM as PROGRESS_BYTES bytes: the last
+   level played, then the fewest moves each level was solved in (0 if it
+   hasn't been solved yet). It takes as many kernel EEPROM blocks as it
+   needs, with ids counting up from PROGRESS_EEPROM_ID. Changes are made to
+   the copy in RAM, and only written out by SaveProgress() when a level is
+   won. A write takes about 100 ms, so paging through the levels doesn't
+   wait on EEPROM. The level being played is saved with the next win.
+*/
+#define PROGRESS_EEPROM_ID 0x4C41
+#define PROGRESS_BLOCK_BYTES 30 // the size of EepromBlockStruct.data
+#define PROGRESS_BYTES (1 + LEVELS)
+#define PROGRESS_BLOCKS ((PROGRESS_BYTES + PROGRESS_BLOCK_BYTES - 1) / PROGRESS_BLOCK_BYTES)
+#define PROGRESS_LAST_LEVEL 0
+#define PROGRESS_BEST_MOVES(level) (level) // levels count from 1
+
+uint8_t progress[PROGRESS_BYTES];
+static uint16_t progressDirty = 0; // one bit per block that needs writing, and 255 levels take 9
+
+static void LoadProgress(void)
 {
-  int8_t laser_x = 0;
-  int8_t laser_y = 1;
-  uint8_t laser_d = D_IN_L;
+  struct EepromBlockStruct block;
+
+  if (!isEepromFormatted())
+    FormatEeprom();
+  for (uint8_t b = 0; b < PROGRESS_BLOCKS; ++b)
+    if (EepromReadBlock(PROGRESS_EEPROM_ID + b, &block) == 0) {
+      uint8_t bytes = PROGRESS_BYTES - b * PROGRESS_BLOCK_BYTES;
+      if (bytes > PROGRESS_BLOCK_BYTES)
+	bytes = PROGRESS_BLOCK_BYTES;
+      memcpy(&progress[b * PROGRESS_BLOCK_BYTES], block.data, bytes);
+    }
 
-  bool bounce = false;
-  bool halt = false;
-  do {
-    // Examine the piece under the current position (laser_x, laser_y)
-    switch (board[laser_y][laser_x] & 0x0F) { // ignore the high word
-    case P_BLANK:
-      switch (laser_d) {
-      case D_IN_T:
-	laser[laser_y][laser_x] |= (D_IN_T | D_OUT_B);
-	laser_y++;
-	break;
-      case D_IN_B:
-	laser[laser_y][laser_x] |= (D_IN_B | D_OUT_T);
-	laser_y--;
-	break;
-      case D_IN_L:
-	laser[laser_y][laser_x] |= (D_IN_L | D_OUT_R);
-	laser_x++;
-	break;
-      case D_IN_R:
-	laser[laser_y][laser_x] |= (D_IN_R | D_OUT_L);
-	laser_x--;
-	break;
-      }
-      break;
+  if ((progress[PROGRESS_LAST_LEVEL] == 0) || (progress[PROGRESS_LAST_LEVEL] > LEVELS))
+    progress[PROGRESS_LAST_LEVEL] = 1;
+}
 
-    case P_BLOCKER:
-      halt = true;
-      break;
+static void SetProgress(const uint8_t i, const uint8_t value)
+{
+  if (progress[i] != value) {
+    progress[i] = value;
+    progressDirty |= 1U << (i / PROGRESS_BLOCK_BYTES);
+  }
+}
 
-    case P_TARGET_T:
-      if (laser_d == D_IN_T)
-	laser[laser_y][laser_x] |= laser_d;
-      halt = true;
-      break;
+static void SaveProgress(void)
+{
+  struct EepromBlockStruct block;
+
+  for (uint8_t b = 0; b < PROGRESS_BLOCKS; ++b)
+    if (progressDirty & (1U << b)) {
+      uint8_t bytes = PROGRESS_BYTES - b * PROGRESS_BLOCK_BYTES;
+      if (bytes > PROGRESS_BLOCK_BYTES)
+	bytes = PROGRESS_BLOCK_BYTES;
+      block.id = PROGRESS_EEPROM_ID + b;
+      memset(block.data, 0, sizeof(block.data));
+      memcpy(block.data, &progress[b * PROGRESS_BLOCK_BYTES], bytes);
+      EepromWriteBlock(&block);
+    }
+  progressDirty = 0;
+}
 
-    case P_TARGET_R:
-      if (laser_d == D_IN_R)
-	laser[laser_y][laser_x] |= laser_d;
-      halt = true;
-      break;
+// Remembers the level being played, to be written out when a level is won.
+// Progress is only kept for the levels in flash, since a level pack can
+// have more levels than would fit in EEPROM.
+static void ChangeLevel(const uint16_t level)
+{
+  if (!levelPack)
+    SetProgress(PROGRESS_LAST_LEVEL, level);
+  LoadLevel(level);
+}
 
-    case P_TARGET_B:
-      if (laser_d == D_IN_B)
-	laser[laser_y][laser_x] |= laser_d;
-      halt = true;
-      break;
+// Records the number of moves if it's the best so far, and writes it out
+// along with the level being played
+static void LevelWon(const uint16_t level)
+{
+  if (levelPack)
+    return;
+  const uint8_t best = progress[PROGRESS_BEST_MOVES(level)];
+  if ((best == 0) || (moves < best))
+    SetProgress(PROGRESS_BEST_MOVES(level), moves ? moves : 1); // 0 means unsolved
+  SaveProgress();
+}
 
-    case P_TARGET_L:
-      if (laser_d == D_IN_L)
-	laser[laser_y][laser_x] |= laser_d;
-      halt = true;
-      break;
+/* What each piece does to a beam coming into it from each side, as D_IN_* and
+   D_OUT_* bits. The D_OUT_* bits say where the beam goes next (splitters send it two
+   ways), and when there are none the beam halts there. Indexed by (piece << 2) | DIR_*
+*/
+const uint8_t beamTable[] PROGMEM = {
+  // P_BLANK
+  D_IN_T | D_OUT_B, D_IN_B | D_OUT_T, D_IN_L | D_OUT_R, D_IN_R | D_OUT_L,
+  // P_BLOCKER
+  0, 0, 0, 0,
+  // P_TARGET_T
+  D_IN_T, 0, 0, 0,
+  // P_TARGET_R
+  0, 0, 0, D_IN_R,
+  // P_TARGET_B
+  0, D_IN_B, 0, 0,
+  // P_TARGET_L
+  0, 0, D_IN_L, 0,
+  // P_MIRROR_BL
+  0, D_IN_B | D_OUT_L, D_IN_L | D_OUT_B, 0,
+  // P_MIRROR_TL
+  D_IN_T | D_OUT_L, 0, D_IN_L | D_OUT_T, 0,
+  // P_MIRROR_TR
+  D_IN_T | D_OUT_R, 0, 0, D_IN_R | D_OUT_T,
+  // P_MIRROR_BR
+  0, D_IN_B | D_OUT_R, 0, D_IN_R | D_OUT_B,
+  // P_SPLIT_TLBR
+  D_IN_T | D_OUT_B | D_OUT_R, D_IN_B | D_OUT_T | D_OUT_L, D_IN_L | D_OUT_R | D_OUT_B, D_IN_R | D_OUT_L | D_OUT_T,
+  // P_SPLIT_TRBL
+  D_IN_T | D_OUT_B | D_OUT_L, D_IN_B | D_OUT_T | D_OUT_R, D_IN_L | D_OUT_R | D_OUT_T, D_IN_R | D_OUT_L | D_OUT_B,
+};
 
-    case P_MIRROR_BL:
-      switch (laser_d) {
-      case D_IN_T:
-	halt = true;
-	break;
-      case D_IN_B:
-	laser[laser_y][laser_x] |= (D_IN_B | D_OUT_L);
-	laser_d = D_IN_R;
-	laser_x--;
-	break;
-      case D_IN_L:
-	laser[laser_y][laser_x] |= (D_IN_L | D_OUT_B);
-	laser_d = D_IN_T;
-	laser_y++;
-	break;
-      case D_IN_R:
-	halt = true;
-	break;
-      }
-      break;
+// The bit of a square in the laser masks. Shifting a long by a variable amount is a
+// loop on the AVR, so there it is read from a table.
+#if defined(__AVR__)
+const uint32_t cellBits[BOARD_MAX_W * BOARD_MAX_H] PROGMEM = {
+  1UL << 0, 1UL << 1, 1UL << 2, 1UL << 3, 1UL << 4,
+  1UL << 5, 1UL << 6, 1UL << 7, 1UL << 8, 1UL << 9,
+  1UL << 10, 1UL << 11, 1UL << 12, 1UL << 13, 1UL << 14,
+  1UL << 15, 1UL << 16, 1UL << 17, 1UL << 18, 1UL << 19,
+  1UL << 20, 1UL << 21, 1UL << 22, 1UL << 23, 1UL << 24,
+};
+#define CELL_BIT(cell) pgm_read_dword(&cellBits[cell])
+#else
+#define CELL_BIT(cell) (1UL << (cell))
+#endif
 
-    case P_MIRROR_TL:
-      switch (laser_d) {
-      case D_IN_T:
-	laser[laser_y][laser_x] |= (D_IN_T | D_OUT_L);
-	laser_d = D_IN_R;
-	laser_x--;
-	break;
-      case D_IN_B:
-	halt = true;
-	break;
-      case D_IN_L:
-	laser[laser_y][laser_x] |= (D_IN_L | D_OUT_T);
-	laser_d = D_IN_B;
-	laser_y--;
-	break;
-      case D_IN_R:
-	halt = true;
-	break;
-      }
-      break;
+// The squares in the first and last columns, where shifting a mask sideways wraps around to another row
+#define FIRST_COLUMN 0x0108421UL
+#define LAST_COLUMN (FIRST_COLUMN << (BOARD_MAX_W - 1))
 
-    case P_MIRROR_TR:
-      switch (laser_d) {
-      case D_IN_T:
-	laser[laser_y][laser_x] |= (D_IN_T | D_OUT_R);
-	laser_d = D_IN_L;
-	laser_x++;
-	break;
-      case D_IN_B:
-	halt = true;
-	break;
-      case D_IN_L:
-	halt = true;
-	break;
-      case D_IN_R:
-	laser[laser_y][laser_x] |= (D_IN_R | D_OUT_T);
-	laser_d = D_IN_B;
-	laser_y--;
-	break;
+// The sides the beam came into the square with the given bit from, as DIR_* bits
+static uint8_t LaserInBits(const uint32_t bit)
+{
+  uint8_t in = 0;
+  if (laserIn[DIR_T] & bit)
+    in |= 1 << DIR_T;
+  if (laserIn[DIR_B] & bit)
+    in |= 1 << DIR_B;
+  if (laserIn[DIR_L] & bit)
+    in |= 1 << DIR_L;
+  if (laserIn[DIR_R] & bit)
+    in |= 1 << DIR_R;
+  return in;
+}
+
+static uint8_t LaserIn(const uint8_t cell)
+{
+  return LaserInBits(CELL_BIT(cell));
+}
+
+// Works out, for each DIR_*, the squares the beam left through that side into another
+// square. A beam leaving the board isn't included, so each bit is a gap to light.
+static void LaserOut(uint32_t* const out)
+{
+  out[DIR_T] = laserIn[DIR_B] << BOARD_MAX_W;
+  out[DIR_B] = laserIn[DIR_T] >> BOARD_MAX_W;
+  out[DIR_L] = (laserIn[DIR_R] << 1) & ~FIRST_COLUMN;
+  out[DIR_R] = (laserIn[DIR_L] >> 1) & ~LAST_COLUMN;
+}
+
+// The D_IN_* and D_OUT_* bits of a square after a trace, for the host tools. Only the
+// sides the beam got in from count, and the D_OUT_* bits come from the piece, so they
+// include the beam leaving the board. They are only right while the board is the way
+// it was traced.
+uint8_t LaserAt(const uint8_t x, const uint8_t y)
+{
+  const uint8_t in = LaserIn(y * BOARD_MAX_W + x);
+  const uint8_t* const bits = &beamTable[(board[y][x] & 0x0F) << 2];
+  uint8_t l = 0;
+  for (uint8_t d = DIR_T; d <= DIR_R; ++d)
+    if (in & (1 << d))
+      l |= pgm_read_byte(&bits[d]);
+  return l;
+}
+
+// Moves (x, y) one square out the given side, and returns the side the beam comes into that square from
+static uint8_t MoveBeam(const uint8_t out, int8_t* const x, int8_t* const y)
+{
+  switch (out) {
+  case D_OUT_T:
+    --*y;
+    return DIR_B;
+  case D_OUT_B:
+    ++*y;
+    return DIR_T;
+  case D_OUT_L:
+    --*x;
+    return DIR_R;
+  default: // D_OUT_R
+    ++*x;
+    return DIR_L;
+  }
+}
+
+/* Splitters queue their second beam here, to be traced after the current beam
+   halts. Each splitter can queue a beam for every side it is lit from, so a
+   board with five or more splitters can need more room than there is. The
+   beams that don't fit are found again once the queue is empty.
+*/
+#define TRACE_QUEUE_SIZE 16
+
+// Returns false if the beam had to be dropped because the queue was full
+static bool QueueBeam(uint8_t* const queue, uint8_t* const queued, const int8_t x, const int8_t y, const uint8_t d)
+{
+  if ((x < 0) || (x >= boardWidth) || (y < 0) || (y >= boardHeight) ||
+      (laserIn[d] & CELL_BIT(y * BOARD_MAX_W + x)))
+    return true;
+  if (*queued == TRACE_QUEUE_SIZE)
+    return false;
+  queue[(*queued)++] = (d << 6) | (y << 3) | x;
+  return true;
+}
+
+// Queues every beam that leaves a square it was traced through into another square that
+// it hasn't come into from that side yet, which are the ones a full queue dropped.
+// Returns false if the queue filled up again.
+static bool RequeueDroppedBeams(uint8_t* const queue, uint8_t* const queued)
+{
+  bool fitted = true;
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x) {
+      const uint8_t in = LaserIn(y * BOARD_MAX_W + x);
+      for (uint8_t d = DIR_T; d <= DIR_R; ++d) {
+	if (!(in & (1 << d)))
+	  continue;
+	const uint8_t bits = pgm_read_byte(&beamTable[((board[y][x] & 0x0F) << 2) | d]);
+	for (uint8_t out = D_OUT_T; out <= D_OUT_R; out <<= 1)
+	  if (bits & out) {
+	    int8_t nx = x;
+	    int8_t ny = y;
+	    const uint8_t nd = MoveBeam(out, &nx, &ny);
+	    if (!QueueBeam(queue, queued, nx, ny, nd))
+	      fitted = false;
+	  }
       }
-      break;
+    }
+  return fitted;
+}
 
-    case P_MIRROR_BR:
-      switch (laser_d) {
-      case D_IN_T:
-	halt = true;
-	break;
-      case D_IN_B:
-	laser[laser_y][laser_x] |= (D_IN_B | D_OUT_R);
-	laser_d = D_IN_L;
-	laser_x++;
-	break;
-      case D_IN_L:
-	halt = true;
-	break;
-      case D_IN_R:
-	laser[laser_y][laser_x] |= (D_IN_R | D_OUT_B);
-	laser_d = D_IN_T;
-	laser_y++;
+#if LOCKED_TRACE
+/* Locked trace
+
+   Built with LOCKED_TRACE=1, traces skip over the locked pieces next to the
+   laser source. Locked pieces stay put for the whole level, so the stretch of
+   the trace from the source up to the first square the player can change
+   comes out the same every time. TraceLaser() keeps all of its state at that
+   point in lockedTrace: the masks, the squares lit so far in litCells[], and
+   the splitter queue. Later traces copy it back and carry on from there.
+
+   Along with that, it keeps the board's size and the pieces in every square
+   the stretch went into. A trace only uses lockedTrace if they are all still
+   the same, so nothing has to invalidate it, however board[] gets written.
+   Each of those squares holds a locked piece, so 4 bits of it are enough.
+*/
+#define LOCKED_PIECE(v) (((v) & 0x80) && (((v) & 0x0F) != P_BLANK)) // pieces can be dropped on locked blanks
+#define LOCKED_TRACE_DONE 0xFF // the beam never left the locked pieces
+
+struct {
+  uint8_t width; // the size of the board it was traced on, or 0 before the first trace
+  uint8_t height;
+  uint8_t beam; // the next square to trace, as (d << 6) | (y << 3) | x, or LOCKED_TRACE_DONE
+  uint8_t queued;
+  bool dropped;
+  uint8_t litCount;
+  uint32_t laserIn[4];
+  uint32_t laserLit;
+  uint8_t litCells[BOARD_MAX_W * BOARD_MAX_H];
+  uint8_t queue[TRACE_QUEUE_SIZE];
+  uint8_t pieces[(BOARD_MAX_W * BOARD_MAX_H + 1) / 2]; // two squares to a byte, even squares in the low nibble
+} lockedTrace;
+
+static void KeepLockedTrace(const uint8_t* const queue, const uint8_t queued, const bool dropped, const uint8_t beam)
+{
+  lockedTrace.width = boardWidth;
+  lockedTrace.height = boardHeight;
+  lockedTrace.beam = beam;
+  lockedTrace.queued = queued;
+  lockedTrace.dropped = dropped;
+  lockedTrace.litCount = litCount;
+  memcpy(lockedTrace.laserIn, laserIn, sizeof(laserIn));
+  lockedTrace.laserLit = laserLit;
+  memcpy(lockedTrace.litCells, litCells, litCount);
+  memcpy(lockedTrace.queue, queue, queued);
+
+  const uint8_t* const squares = &board[0][0];
+  uint32_t reached = laserIn[DIR_T] | laserIn[DIR_B] | laserIn[DIR_L] | laserIn[DIR_R];
+  memset(lockedTrace.pieces, 0, sizeof(lockedTrace.pieces));
+  for (uint8_t cell = 0; reached; ++cell, reached >>= 1)
+    if (reached & 1)
+      lockedTrace.pieces[cell >> 1] |= (squares[cell] & 0x0F) << ((cell & 1) << 2);
+}
+
+// Whether lockedTrace was kept for a board with the same pieces everywhere it went
+static bool LockedTraceMatches(void)
+{
+  if ((lockedTrace.width != boardWidth) || (lockedTrace.height != boardHeight))
+    return false;
+  const uint8_t* const squares = &board[0][0];
+  uint32_t reached = lockedTrace.laserIn[DIR_T] | lockedTrace.laserIn[DIR_B] |
+    lockedTrace.laserIn[DIR_L] | lockedTrace.laserIn[DIR_R];
+  for (uint8_t cell = 0; reached; ++cell, reached >>= 1)
+    if ((reached & 1) &&
+	(squares[cell] != (0x80 | ((lockedTrace.pieces[cell >> 1] >> ((cell & 1) << 2)) & 0x0F))))
+      return false;
+  return true;
+}
+#endif
+
+/*
+ * TraceLaser
+ *
+ * Fills in laserIn[] by following the beam from the laser source at
+ * (0, 1) until every branch halts or leaves the board. Each step is a
+ * lookup in beamTable.
+ *
+ * Splitters send the beam both ways at once: one beam is followed
+ * immediately, and the other is queued and followed once the current
+ * one halts. The masks in laserIn[] double as a visited mask, so
+ * no (x, y, direction) state is traced twice, beams that loop back on
+ * themselves terminate, and the result is the same every time.
+ *
+ * With LOCKED_TRACE, the trace starts from where the beam first leaves
+ * the locked pieces, if the last one it kept in lockedTrace still fits.
+ */
+void TraceLaser(void)
+{
+  uint8_t queue[TRACE_QUEUE_SIZE];
+  uint8_t queued;
+  bool dropped; // whether a beam didn't fit in the queue
+  uint8_t beam;
+
+  laserShown = 0;
+#if LOCKED_TRACE
+  bool locked = !LockedTraceMatches(); // still on squares that lockedTrace will cover
+  if (!locked) {
+    memcpy(laserIn, lockedTrace.laserIn, sizeof(laserIn));
+    laserLit = lockedTrace.laserLit;
+    litCount = lockedTrace.litCount;
+    memcpy(litCells, lockedTrace.litCells, litCount);
+    queued = lockedTrace.queued;
+    memcpy(queue, lockedTrace.queue, queued);
+    dropped = lockedTrace.dropped;
+    beam = lockedTrace.beam;
+    if (beam == LOCKED_TRACE_DONE)
+      return;
+  } else
+#endif
+  {
+    memset(laserIn, 0, sizeof(laserIn));
+    laserLit = 0;
+    litCount = 0;
+    queued = 0;
+    dropped = false;
+    beam = (DIR_L << 6) | (1 << 3) | 0; // the laser source
+  }
+
+  for (;;) {
+    int8_t laser_x = beam & 0x07;
+    int8_t laser_y = (beam >> 3) & 0x07;
+    uint8_t laser_d = beam >> 6;
+
+    for (;;) {
+      // Nothing new to find if a beam has already come through here in the same direction
+      const uint32_t bit = CELL_BIT(laser_y * BOARD_MAX_W + laser_x);
+      if (laserIn[laser_d] & bit)
 	break;
+#if LOCKED_TRACE
+      // Everything up to here will be traced the same way again, while these pieces stay put
+      if (locked && !LOCKED_PIECE(board[laser_y][laser_x])) {
+	KeepLockedTrace(queue, queued, dropped, (laser_d << 6) | (laser_y << 3) | laser_x);
+	locked = false;
+      }
+#endif
+      laserIn[laser_d] |= bit;
+
+      // Look up what the piece under the current position (laser_x, laser_y) does to the beam.
+      // The first beam to light up a square adds it to the ones DrawLaser() has to redraw.
+      const uint8_t bits = pgm_read_byte(&beamTable[((board[laser_y][laser_x] & 0x0F) << 2) | laser_d]);
+      if (bits && !(laserLit & bit)) {
+	laserLit |= bit;
+	litCells[litCount++] = (laser_y << 4) | laser_x;
       }
-      break;
 
-    case P_SPLIT_TLBR:
-      // Generate a random number, and decide whether the beam passes through, or bounces
-      bounce = (rand() > (RAND_MAX / 2));
-      switch (laser_d) {
-      case D_IN_T:
-	if (bounce) {
-	  laser[laser_y][laser_x] |= (D_IN_T | D_OUT_R);
-	  laser_d = D_IN_L;
-	  laser_x++;
-	} else {
-	  laser[laser_y][laser_x] |= (D_IN_T | D_OUT_B);
-	  laser_y++;
-	}
-	break;
-      case D_IN_B:
-	if (bounce) {
-	  laser[laser_y][laser_x] |= (D_IN_B | D_OUT_L);
-	  laser_d = D_IN_R;
-	  laser_x--;
-	} else {
-	  laser[laser_y][laser_x] |= (D_IN_B | D_OUT_T);
-	  laser_y--;
-	}
-	break;
-      case D_IN_L:
-	if (bounce) {
-	  laser[laser_y][laser_x] |= (D_IN_L | D_OUT_B);
-	  laser_d = D_IN_T;
-	  laser_y++;
-	} else {
-	  laser[laser_y][laser_x] |= (D_IN_L | D_OUT_R);
-	  laser_x++;
-	}
-	break;
-      case D_IN_R:
-	if (bounce) {
-	  laser[laser_y][laser_x] |= (D_IN_R | D_OUT_T);
-	  laser_d = D_IN_B;
-	  laser_y--;
-	} else {
-	  laser[laser_y][laser_x] |= (D_IN_R | D_OUT_L);
-	  laser_x--;
-	}
-	break;
+      const uint8_t out = bits & (D_OUT_T | D_OUT_B | D_OUT_L | D_OUT_R);
+      const uint8_t first = out & -out;
+      if (out != first) { // a splitter, so queue the other beam
+	int8_t x = laser_x;
+	int8_t y = laser_y;
+	const uint8_t d = MoveBeam(out ^ first, &x, &y);
+	if (!QueueBeam(queue, &queued, x, y, d))
+	  dropped = true;
       }
-      break;
-      
-    case P_SPLIT_TRBL:
-      // Generate a random number, and decide whether the beam passes through, or bounces
-      bounce = (rand() > (RAND_MAX / 2));
-      switch (laser_d) {
-      case D_IN_T:
-	if (bounce) {
-	  laser[laser_y][laser_x] |= (D_IN_T | D_OUT_L);
-	  laser_d = D_IN_R;
-	  laser_x--;
-	} else {
-	  laser[laser_y][laser_x] |= (D_IN_T | D_OUT_B);
-	  laser_y++;
-	}
+      if (!first) // halt
 	break;
-      case D_IN_B:
-	if (bounce) {
-	  laser[laser_y][laser_x] |= (D_IN_B | D_OUT_R);
-	  laser_d = D_IN_L;
-	  laser_x++;
-	} else {
-	  laser[laser_y][laser_x] |= (D_IN_B | D_OUT_T);
-	  laser_y--;
-	}
-	break;
-      case D_IN_L:
-	if (bounce) {
-	  laser[laser_y][laser_x] |= (D_IN_L | D_OUT_T);
-	  laser_d = D_IN_B;
-	  laser_y--;
-	} else {
-	  laser[laser_y][laser_x] |= (D_IN_L | D_OUT_R);
-	  laser_x++;
-	}
-	break;
-      case D_IN_R:
-	if (bounce) {
-	  laser[laser_y][laser_x] |= (D_IN_R | D_OUT_B);
-	  laser_d = D_IN_T;
-	  laser_y++;
-	} else {
-	  laser[laser_y][laser_x] |= (D_IN_R | D_OUT_L);
-	  laser_x--;
-	}
+      laser_d = MoveBeam(first, &laser_x, &laser_y);
+      if ((laser_x < 0) || (laser_x >= boardWidth) || (laser_y < 0) || (laser_y >= boardHeight))
 	break;
-      }
-      break;
-      
     }
-  } while (!halt && laser_x >= 0 && laser_x <= 4 &&
-	   laser_y >= 0 && laser_y <= 4);
 
+    if ((queued == 0) && dropped)
+      dropped = !RequeueDroppedBeams(queue, &queued);
+    if (queued == 0)
+      break;
+
+    // Pick up the next beam that a splitter left behind
+    beam = queue[--queued];
+  }
+
+#if LOCKED_TRACE
+  if (locked) // every beam halted on locked pieces
+    KeepLockedTrace(queue, queued, dropped, LOCKED_TRACE_DONE);
+#endif
+}
+
+/* The tiles a square is drawn with when the laser goes through it. What the beam
+   does in a square only depends on the piece and the sides it came in from, so
+   litTiles[] is indexed by (piece << 4) | LaserIn(), and gives the entry in
+   litMaps[] to draw, or LIT_NONE to leave the square alone. Each line of a
+   piece has the four ways in from the top and bottom, for one way in from the
+   left and right. The sides a piece stops the beam from make no difference to
+   the entry, so LaserIn() can include them.
+*/
+enum {
+  LIT_NONE, // leave the square the way it is
+  LIT_BLANK_H, LIT_BLANK_V, LIT_BLANK_HV,
+  LIT_TARGET_T, LIT_TARGET_R, LIT_TARGET_B, LIT_TARGET_L,
+  LIT_MIRROR_BL, LIT_MIRROR_TL, LIT_MIRROR_TR, LIT_MIRROR_BR,
+  LIT_SPLIT_TLBR_L, LIT_SPLIT_TLBR_T, LIT_SPLIT_TLBR_R, LIT_SPLIT_TLBR_B, LIT_SPLIT_TLBR_A,
+  LIT_SPLIT_TRBL_L, LIT_SPLIT_TRBL_T, LIT_SPLIT_TRBL_R, LIT_SPLIT_TRBL_B, LIT_SPLIT_TRBL_A,
+};
+
+const VRAM_PTR_TYPE* const litMaps[] PROGMEM = {
+  map_blank_on_h, map_blank_on_v, map_blank_on_hv,
+  map_target_t_on, map_target_r_on, map_target_b_on, map_target_l_on,
+  map_mirror_bl_on, map_mirror_tl_on, map_mirror_tr_on, map_mirror_br_on,
+  map_split_tlbr_on_l, map_split_tlbr_on_t, map_split_tlbr_on_r, map_split_tlbr_on_b, map_split_tlbr_on_a,
+  map_split_trbl_on_l, map_split_trbl_on_t, map_split_trbl_on_r, map_split_trbl_on_b, map_split_trbl_on_a,
+};
+
+const uint8_t litTiles[] PROGMEM = {
+  // P_BLANK
+  LIT_NONE, LIT_BLANK_V, LIT_BLANK_V, LIT_BLANK_V,
+  LIT_BLANK_H, LIT_BLANK_HV, LIT_BLANK_HV, LIT_BLANK_HV,
+  LIT_BLANK_H, LIT_BLANK_HV, LIT_BLANK_HV, LIT_BLANK_HV,
+  LIT_BLANK_H, LIT_BLANK_HV, LIT_BLANK_HV, LIT_BLANK_HV,
+  // P_BLOCKER
+  LIT_NONE, LIT_NONE, LIT_NONE, LIT_NONE,
+  LIT_NONE, LIT_NONE, LIT_NONE, LIT_NONE,
+  LIT_NONE, LIT_NONE, LIT_NONE, LIT_NONE,
+  LIT_NONE, LIT_NONE, LIT_NONE, LIT_NONE,
+  // P_TARGET_T
+  LIT_NONE, LIT_TARGET_T, LIT_NONE, LIT_TARGET_T,
+  LIT_NONE, LIT_TARGET_T, LIT_NONE, LIT_TARGET_T,
+  LIT_NONE, LIT_TARGET_T, LIT_NONE, LIT_TARGET_T,
+  LIT_NONE, LIT_TARGET_T, LIT_NONE, LIT_TARGET_T,
+  // P_TARGET_R
+  LIT_NONE, LIT_NONE, LIT_NONE, LIT_NONE,
+  LIT_NONE, LIT_NONE, LIT_NONE, LIT_NONE,
+  LIT_TARGET_R, LIT_TARGET_R, LIT_TARGET_R, LIT_TARGET_R,
+  LIT_TARGET_R, LIT_TARGET_R, LIT_TARGET_R, LIT_TARGET_R,
+  // P_TARGET_B
+  LIT_NONE, LIT_NONE, LIT_TARGET_B, LIT_TARGET_B,
+  LIT_NONE, LIT_NONE, LIT_TARGET_B, LIT_TARGET_B,
+  LIT_NONE, LIT_NONE, LIT_TARGET_B, LIT_TARGET_B,
+  LIT_NONE, LIT_NONE, LIT_TARGET_B, LIT_TARGET_B,
+  // P_TARGET_L
+  LIT_NONE, LIT_NONE, LIT_NONE, LIT_NONE,
+  LIT_TARGET_L, LIT_TARGET_L, LIT_TARGET_L, LIT_TARGET_L,
+  LIT_NONE, LIT_NONE, LIT_NONE, LIT_NONE,
+  LIT_TARGET_L, LIT_TARGET_L, LIT_TARGET_L, LIT_TARGET_L,
+  // P_MIRROR_BL
+  LIT_NONE, LIT_NONE, LIT_MIRROR_BL, LIT_MIRROR_BL,
+  LIT_MIRROR_BL, LIT_MIRROR_BL, LIT_MIRROR_BL, LIT_MIRROR_BL,
+  LIT_NONE, LIT_NONE, LIT_MIRROR_BL, LIT_MIRROR_BL,
+  LIT_MIRROR_BL, LIT_MIRROR_BL, LIT_MIRROR_BL, LIT_MIRROR_BL,
+  // P_MIRROR_TL
+  LIT_NONE, LIT_MIRROR_TL, LIT_NONE, LIT_MIRROR_TL,
+  LIT_MIRROR_TL, LIT_MIRROR_TL, LIT_MIRROR_TL, LIT_MIRROR_TL,
+  LIT_NONE, LIT_MIRROR_TL, LIT_NONE, LIT_MIRROR_TL,
+  LIT_MIRROR_TL, LIT_MIRROR_TL, LIT_MIRROR_TL, LIT_MIRROR_TL,
+  // P_MIRROR_TR
+  LIT_NONE, LIT_MIRROR_TR, LIT_NONE, LIT_MIRROR_TR,
+  LIT_NONE, LIT_MIRROR_TR, LIT_NONE, LIT_MIRROR_TR,
+  LIT_MIRROR_TR, LIT_MIRROR_TR, LIT_MIRROR_TR, LIT_MIRROR_TR,
+  LIT_MIRROR_TR, LIT_MIRROR_TR, LIT_MIRROR_TR, LIT_MIRROR_TR,
+  // P_MIRROR_BR
+  LIT_NONE, LIT_NONE, LIT_MIRROR_BR, LIT_MIRROR_BR,
+  LIT_NONE, LIT_NONE, LIT_MIRROR_BR, LIT_MIRROR_BR,
+  LIT_MIRROR_BR, LIT_MIRROR_BR, LIT_MIRROR_BR, LIT_MIRROR_BR,
+  LIT_MIRROR_BR, LIT_MIRROR_BR, LIT_MIRROR_BR, LIT_MIRROR_BR,
+  // P_SPLIT_TLBR
+  LIT_NONE, LIT_SPLIT_TLBR_T, LIT_SPLIT_TLBR_B, LIT_SPLIT_TLBR_A,
+  LIT_SPLIT_TLBR_L, LIT_SPLIT_TLBR_A, LIT_SPLIT_TLBR_A, LIT_SPLIT_TLBR_A,
+  LIT_SPLIT_TLBR_R, LIT_SPLIT_TLBR_A, LIT_SPLIT_TLBR_A, LIT_SPLIT_TLBR_A,
+  LIT_SPLIT_TLBR_A, LIT_SPLIT_TLBR_A, LIT_SPLIT_TLBR_A, LIT_SPLIT_TLBR_A,
+  // P_SPLIT_TRBL
+  LIT_NONE, LIT_SPLIT_TRBL_T, LIT_SPLIT_TRBL_B, LIT_SPLIT_TRBL_A,
+  LIT_SPLIT_TRBL_L, LIT_SPLIT_TRBL_A, LIT_SPLIT_TRBL_A, LIT_SPLIT_TRBL_A,
+  LIT_SPLIT_TRBL_R, LIT_SPLIT_TRBL_A, LIT_SPLIT_TRBL_A, LIT_SPLIT_TRBL_A,
+  LIT_SPLIT_TRBL_A, LIT_SPLIT_TRBL_A, LIT_SPLIT_TRBL_A, LIT_SPLIT_TRBL_A,
+};
+
+// Draws one of the squares the laser went through, and the beam leaving it. out[] is from LaserOut().
+static void DrawLaserSquare(const uint8_t cell, const uint32_t* const out)
+{
+  const uint8_t x = cell & 0x0F;
+  const uint8_t y = cell >> 4;
+  const uint32_t bit = CELL_BIT(y * BOARD_MAX_W + x);
+  const uint8_t piece = board[y][x] & 0x0F; // ignore the high word
+  const uint8_t lit = pgm_read_byte(&litTiles[(piece << 4) | LaserInBits(bit)]);
+  if (lit != LIT_NONE)
+    DrawMap(9 + x * 4, 1 + y * 4, (const VRAM_PTR_TYPE*)pgm_read_ptr(&litMaps[lit - 1]));
+
+  // Fill in the gaps between this square and the ones it shines into
+  if (out[DIR_R] & bit)
+    DrawMap(12 + x * 4, 2 + y * 4, map_gap_h);
+  if (out[DIR_L] & bit)
+    DrawMap(8 + x * 4, 2 + y * 4, map_gap_h);
+  if (out[DIR_B] & bit)
+    DrawMap(10 + x * 4, 4 + y * 4, map_gap_v);
+  if (out[DIR_T] & bit)
+    DrawMap(10 + x * 4, y * 4, map_gap_v);
 }
 
 void DrawLaser(void)
 {
+  uint32_t out[4];
+  LaserOut(out);
   DrawMap(7, 5, map_laser_source);
-  for (uint8_t y = 0; y < 5; ++y) {
-    for (uint8_t x = 0; x < 5; ++x) {
-      uint8_t l = laser[y][x];
-      switch (board[y][x] & 0x0F) { // ignore the high word
-      case P_BLANK:
-	{
-	  bool h = ((l & D_IN_L) && (l & D_OUT_R)) || ((l & D_IN_R) && (l & D_OUT_L));
-	  bool v = ((l & D_IN_T) && (l & D_OUT_B)) || ((l & D_IN_B) && (l & D_OUT_T));
-	  if (h && v)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_blank_on_hv);
-	  else if (h)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_blank_on_h);
-	  else if (v)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_blank_on_v);
-	}
-	break;
+  for (uint8_t i = 0; i < litCount; ++i)
+    DrawLaserSquare(litCells[i], out);
+  laserShown = litCount;
+}
 
-      case P_TARGET_T:
-	if (l & D_IN_T)
-	  DrawMap(9 + x * 4, 1 + y * 4, map_target_t_on);
-	break;
+/* The beam can also be drawn a few squares per frame, in the order the
+   tracer lit them, so it can be seen travelling across the board and no
+   frame has to draw all of it. Returns true once it's all drawn.
+*/
+#define LASER_SQUARES_PER_FRAME 1
 
-      case P_TARGET_R:
-	if (l & D_IN_R)
-	  DrawMap(9 + x * 4, 1 + y * 4, map_target_r_on);
-	break;
+bool DrawLaserStep(void)
+{
+  uint32_t out[4];
+  LaserOut(out);
+  if (laserShown == 0)
+    DrawMap(7, 5, map_laser_source);
+  for (uint8_t i = 0; (i < LASER_SQUARES_PER_FRAME) && (laserShown < litCount); ++i)
+    DrawLaserSquare(litCells[laserShown++], out);
+  return laserShown == litCount;
+}
 
-      case P_TARGET_B:
-	if (l & D_IN_B)
-	  DrawMap(9 + x * 4, 1 + y * 4, map_target_b_on);
-	break;
+// Only the squares the laser has been drawn on need to be put back
+void EraseLaser(void)
+{
+  uint32_t out[4];
+  LaserOut(out);
+  for (uint8_t i = 0; i < laserShown; ++i) {
+    const uint8_t x = litCells[i] & 0x0F;
+    const uint8_t y = litCells[i] >> 4;
+    const uint32_t bit = CELL_BIT(y * BOARD_MAX_W + x);
+    DrawMap(9 + x * 4, 1 + y * 4, MapName(board[y][x] & 0x0F));
+
+    // Erase any lasers between this square and the ones it shines into
+    if (out[DIR_R] & bit)
+      SetTile(12 + x * 4, 2 + y * 4, TILE_BACKGROUND);
+    if (out[DIR_L] & bit)
+      SetTile(8 + x * 4, 2 + y * 4, TILE_BACKGROUND);
+    if (out[DIR_B] & bit)
+      SetTile(10 + x * 4, 4 + y * 4, TILE_BACKGROUND);
+    if (out[DIR_T] & bit)
+      SetTile(10 + x * 4, y * 4, TILE_BACKGROUND);
+  }
+  laserShown = 0;
+  DrawMap(7, 5, map_laser_source_off);
+}
 
-      case P_TARGET_L:
-	if (l & D_IN_L)
-	  DrawMap(9 + x * 4, 1 + y * 4, map_target_l_on);
-	break;
+/* Live laser
 
-      case P_MIRROR_BL:
-	if (((l & D_IN_B) && (l & D_OUT_L)) ||
-	    ((l & D_IN_L) && (l & D_OUT_B)))
-	  DrawMap(9 + x * 4, 1 + y * 4, map_mirror_bl_on);
-	break;
+   Built with LIVE_LASER=1, the beam is always on the screen. Whenever a piece
+   is picked up, dropped, or turned on the board, the laser is traced again, and
+   the new laserIn[] is compared with the one that is drawn, so only the squares
+   whose beam changed (and the ones the move drew over) are redrawn. Y then just
+   checks whether the puzzle is solved.
+*/
+#if LIVE_LASER
+uint32_t laserDrawn[4]; // laserIn[] as it is on the screen
+uint32_t squaresRedrawn; // board squares drawn without the beam since the last update, one bit each
 
-      case P_MIRROR_TL:
-	if (((l & D_IN_T) && (l & D_OUT_L)) ||
-	    ((l & D_IN_L) && (l & D_OUT_T)))
-	  DrawMap(9 + x * 4, 1 + y * 4, map_mirror_tl_on);
-	break;
+#define SQUARE_REDRAWN(x, y) (squaresRedrawn |= 1UL << ((y) * BOARD_MAX_W + (x)))
 
-      case P_MIRROR_TR:
-	if (((l & D_IN_T) && (l & D_OUT_R)) ||
-	    ((l & D_IN_R) && (l & D_OUT_T)))
-	  DrawMap(9 + x * 4, 1 + y * 4, map_mirror_tr_on);
-	break;
+// Draws the gap on one side of a square, lit if the beam crosses it either way
+static void DrawLiveGap(const uint8_t x, const uint8_t y, const uint8_t out)
+{
+  int8_t nx = x;
+  int8_t ny = y;
+  const uint8_t d = MoveBeam(out, &nx, &ny);
+  if ((nx < 0) || (nx >= boardWidth) || (ny < 0) || (ny >= boardHeight))
+    return;
+  // The beam crosses it into the other square from side d, or into this one from the opposite side
+  const bool lit = (laserIn[d] & CELL_BIT(ny * BOARD_MAX_W + nx)) || (laserIn[d ^ 1] & CELL_BIT(y * BOARD_MAX_W + x));
+  const uint8_t h = (out == D_OUT_R) ? 12 : (out == D_OUT_L) ? 8 : 10;
+  const uint8_t v = (out == D_OUT_B) ? 4 : (out == D_OUT_T) ? 0 : 2;
+  if (!lit)
+    SetTile(h + x * 4, v + y * 4, TILE_BACKGROUND);
+  else if (v == 2)
+    DrawMap(h + x * 4, v + y * 4, map_gap_h);
+  else
+    DrawMap(h + x * 4, v + y * 4, map_gap_v);
+}
 
-      case P_MIRROR_BR:
-	if (((l & D_IN_B) && (l & D_OUT_R)) ||
-	    ((l & D_IN_R) && (l & D_OUT_B)))
-	  DrawMap(9 + x * 4, 1 + y * 4, map_mirror_br_on);
-	break;
+// Traces the laser again after the board changed, and redraws just the squares whose beam changed
+static void UpdateLiveLaser(void)
+{
+  TraceLaser();
+
+  // A square's lit tile only depends on the sides the beam came in from, and a gap changes
+  // with the beam coming into the squares on either side of it, which are both redrawn
+  uint32_t changed = squaresRedrawn;
+  for (uint8_t d = DIR_T; d <= DIR_R; ++d)
+    changed |= laserIn[d] ^ laserDrawn[d];
+
+  uint32_t out[4];
+  LaserOut(out);
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x) {
+      const uint8_t cell = y * BOARD_MAX_W + x;
+      if (!(changed & (1UL << cell)))
+	continue;
+      if (!(squaresRedrawn & (1UL << cell)))
+	DrawMap(9 + x * 4, 1 + y * 4, MapName(board[y][x] & 0x0F));
+      if (laserLit & (1UL << cell))
+	DrawLaserSquare((y << 4) | x, out);
+      // The gaps around it can be lit by its neighbours too, so they are worked out from both sides
+      for (uint8_t out = D_OUT_T; out <= D_OUT_R; out <<= 1)
+	DrawLiveGap(x, y, out);
+    }
 
-      case P_SPLIT_TLBR:
-	{
-	  bool in_l = (l & D_IN_L) && (l & D_OUT_R) && (l & D_OUT_B);
-	  bool in_t = (l & D_IN_T) && (l & D_OUT_B) && (l & D_OUT_R);
-	  bool in_r = (l & D_IN_R) && (l & D_OUT_L) && (l & D_OUT_T);
-	  bool in_b = (l & D_IN_B) && (l & D_OUT_T) && (l & D_OUT_L);
-	  if (in_l && !in_t && !in_r && !in_b)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_tlbr_on_l);
-	  else if (in_t && !in_l && !in_r && !in_b)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_tlbr_on_t);
-	  else if (in_r && !in_l && !in_t && !in_b)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_tlbr_on_r);
-	  else if (in_b && !in_l && !in_t && !in_r)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_tlbr_on_b);
-	  else if (in_l || in_t || in_r || in_b)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_tlbr_on_a);
-	}
-	break;
+  memcpy(laserDrawn, laserIn, sizeof(laserIn));
+  squaresRedrawn = 0;
+  laserShown = litCount;
+}
 
-      case P_SPLIT_TRBL:
-	{
-	  bool in_l = (l & D_IN_L) && (l & D_OUT_R) && (l & D_OUT_T);
-	  bool in_t = (l & D_IN_T) && (l & D_OUT_B) && (l & D_OUT_L);
-	  bool in_r = (l & D_IN_R) && (l & D_OUT_L) && (l & D_OUT_B);
-	  bool in_b = (l & D_IN_B) && (l & D_OUT_T) && (l & D_OUT_R);
-	  if (in_l && !in_t && !in_r && !in_b)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_trbl_on_l);
-	  else if (in_t && !in_l && !in_r && !in_b)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_trbl_on_t);
-	  else if (in_r && !in_l && !in_t && !in_b)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_trbl_on_r);
-	  else if (in_b && !in_l && !in_t && !in_r)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_trbl_on_b);
-	  else if (in_l || in_t || in_r || in_b)
-	    DrawMap(9 + x * 4, 1 + y * 4, map_split_trbl_on_a);
-	}
-	break;
-      }
-    }
-  }
-  // Fill in the gaps between squares with lasers
-  for (uint8_t y = 0; y < 5; ++y)
-    for (uint8_t x = 0; x < 4; ++x)
-      if ((laser[y][x] & D_OUT_R) || (laser[y][x + 1] & D_OUT_L))
-	DrawMap(12 + x * 4, 2 + y * 4, map_gap_h);
-  for (uint8_t y = 0; y < 4; ++y)
-    for (uint8_t x = 0; x < 5; ++x)
-      if ((laser[y][x] & D_OUT_B) || (laser[y + 1][x] & D_OUT_T))
-	DrawMap(10 + x * 4, 4 + y * 4, map_gap_v);
+// Puts the whole beam on a level that was just loaded
+static void ShowLiveLaser(void)
+{
+  TraceLaser();
+  DrawLaser();
+  memcpy(laserDrawn, laserIn, sizeof(laserIn));
+  squaresRedrawn = 0;
 }
 
-void EraseLaser(void)
+// Takes the beam off before the level changes, so LoadLevel() finds the board the way it left it
+static void HideLiveLaser(void)
 {
-  for (uint8_t y = 0; y < 5; ++y)
-    for (uint8_t x = 0; x < 5; ++x)
-      DrawMap(9 + x * 4, 1 + y * 4, MapName(board[y][x] & 0x0F));
-      
-  // Erase any lasers between squares
-  for (uint8_t y = 0; y < 5; ++y)
-    for (uint8_t x = 0; x < 4; ++x)
-      if ((laser[y][x] & D_OUT_R) || (laser[y][x + 1] & D_OUT_L))
-	SetTile(12 + x * 4, 2 + y * 4, TILE_BACKGROUND);
-  for (uint8_t y = 0; y < 4; ++y)
-    for (uint8_t x = 0; x < 5; ++x)
-      if ((laser[y][x] & D_OUT_B) || (laser[y + 1][x] & D_OUT_T))
-	SetTile(10 + x * 4, 4 + y * 4, TILE_BACKGROUND);
-  DrawMap(7, 5, map_laser_source_off);
+  TraceLaser(); // the hint solver traces boards of its own, so this gets back the one that is drawn
+  laserShown = litCount;
+  EraseLaser();
 }
+#else
+#define SQUARE_REDRAWN(x, y)
+#endif
 
 const int8_t hitMap[] PROGMEM = {
   0, 0, 0, -1,
@@ -1316,39 +1289,652 @@ const uint8_t rotateCounterClockwise[] PROGMEM = {
   P_SPLIT_TLBR,
 };
 
+// A blank cell the solver has not decided on yet. It stops the beam like a blocker would.
+#define P_UNDECIDED (0x40 | P_BLOCKER)
+
+// Every piece other than a blocker has to have the laser shining into it. Targets
+// only record the beam when it comes in from the proper side, so they are covered too.
+static bool AllPiecesLit(void)
+{
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x) {
+      uint8_t piece = board[y][x] & 0x0F;
+      if ((piece != P_BLANK) && (piece != P_BLOCKER) && !(laserLit & CELL_BIT(y * BOARD_MAX_W + x)))
+	return false;
+    }
+  return true;
+}
+
+// Check to see if the puzzle has been solved: every piece that isn't a blocker has
+// to be out of the hand and on the board, and the laser has to be shining into it
+static bool IsSolved(void)
+{
+  for (uint8_t i = 0; i < 5; ++i)
+    if ((hand[i] != P_BLANK) && (hand[i] != P_BLOCKER))
+      return false;
+  return AllPiecesLit();
+}
+
+static bool IsRotationOf(const uint8_t piece, uint8_t other)
+{
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (piece == other)
+      return true;
+    other = pgm_read_byte(&rotateClockwise[other]);
+  }
+  return false;
+}
+
+// The results of the last search
+uint16_t solutionCount;
+uint8_t solutionPieces;
+uint8_t solutionCell[5]; // y * BOARD_MAX_W + x
+uint8_t solutionPiece[5];
+
+static uint16_t solutionLimit;
+
+/* The search keeps a stack of its own, rather than making recursive calls,
+   so the game can stop it at the end of a frame and pick it up again in
+   the next. It works on its own copy of the board and hand, which are
+   swapped in while it runs. Each entry on the stack is a cell the beam
+   ran into, and the hand slot of the piece that's been put there, or
+   SOLVE_BLANK while the cell is being left empty. */
+#define SOLVE_BLANK 0xFF
+#define SOLVE_DONE 0xFF // solveDepth once the search is over
+
+// Each trace of the beam is about as long as TraceLaser() takes on the screen's board
+#define HINT_TRACES_PER_FRAME 6
+
+static uint8_t solveBoard[BOARD_MAX_H][BOARD_MAX_W];
+static uint8_t solveHand[5];
+static uint8_t solveLeft; // the hand pieces that aren't in a cell on the stack
+static uint8_t solveDepth = SOLVE_DONE;
+static uint8_t solveCell[BOARD_MAX_W * BOARD_MAX_H];
+static uint8_t solveSlot[BOARD_MAX_W * BOARD_MAX_H];
+
+static void SwapSolveBoard(void)
+{
+  uint8_t* const squares = &board[0][0];
+  uint8_t* const solveSquares = &solveBoard[0][0];
+  for (uint8_t i = 0; i < sizeof(board); ++i) {
+    const uint8_t piece = squares[i];
+    squares[i] = solveSquares[i];
+    solveSquares[i] = piece;
+  }
+  for (uint8_t i = 0; i < sizeof(hand); ++i) {
+    const uint8_t piece = hand[i];
+    hand[i] = solveHand[i];
+    solveHand[i] = piece;
+  }
+}
+
+static void RecordSolution(uint8_t blockers)
+{
+  solutionPieces = 0;
+  for (uint8_t i = 0; i < BOARD_MAX_W * BOARD_MAX_H; ++i) {
+    uint8_t piece = board[i / BOARD_MAX_W][i % BOARD_MAX_W];
+    if (piece == P_UNDECIDED) {
+      if (blockers == 0)
+	continue;
+      --blockers;
+      piece = P_BLOCKER;
+    } else if ((piece & 0x80) || (piece == P_BLANK)) {
+      continue;
+    }
+    solutionCell[solutionPieces] = i;
+    solutionPiece[solutionPieces] = piece;
+    ++solutionPieces;
+  }
+}
+
+// Follows the beam until it runs into a cell that hasn't been decided on, and pushes
+// that cell, left blank. Returns false when the beam is finished instead, once the
+// solutions that board makes have been counted.
+static bool SolveDeeper(void)
+{
+  TraceLaser();
+
+  // Undecided cells stop the beam, so it runs into the ones it reaches
+  const uint32_t reached = laserIn[DIR_T] | laserIn[DIR_B] | laserIn[DIR_L] | laserIn[DIR_R];
+  uint8_t cell = 0xFF;
+  uint8_t undecided = 0;
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x)
+      if (board[y][x] == P_UNDECIDED) {
+	++undecided;
+	if ((cell == 0xFF) && (reached & CELL_BIT(y * BOARD_MAX_W + x)))
+	  cell = y * BOARD_MAX_W + x;
+      }
+
+  if (cell == 0xFF) { // the beam is finished, so any undecided cells stay blank
+    uint8_t blockers = 0;
+    for (uint8_t i = 0; i < 5; ++i)
+      if (solveLeft & (1 << i)) {
+	if (hand[i] != P_BLOCKER)
+	  return false; // every piece that isn't a blocker has to be in the beam
+	++blockers;
+      }
+    if (!AllPiecesLit())
+      return false;
+    if (solutionCount == 0)
+      RecordSolution(blockers);
+    // Left over blockers can go on any of the cells the beam doesn't reach
+    uint16_t ways = 1;
+    for (uint8_t i = 0; i < blockers; ++i)
+      ways = ways * (undecided - i) / (i + 1);
+    solutionCount = (ways < solutionLimit - solutionCount) ? (solutionCount + ways) : solutionLimit;
+    return false;
+  }
+
+  board[cell / BOARD_MAX_W][cell % BOARD_MAX_W] = P_BLANK;
+  solveCell[solveDepth] = cell;
+  solveSlot[solveDepth] = SOLVE_BLANK;
+  ++solveDepth;
+  return true;
+}
+
+// Tries the next piece or rotation in the cell on top of the stack, after leaving it
+// blank, and pops the cells that have nothing left to try. Returns false once the
+// stack is empty.
+static bool SolveNext(void)
+{
+  while (solveDepth) {
+    const uint8_t cell = solveCell[solveDepth - 1];
+    uint8_t* const square = &board[cell / BOARD_MAX_W][cell % BOARD_MAX_W];
+    uint8_t i = solveSlot[solveDepth - 1];
+    if (i == SOLVE_BLANK) {
+      i = 0;
+    } else {
+      solveLeft |= (1 << i);
+      const uint8_t piece = pgm_read_byte(&rotateClockwise[*square]);
+      if ((piece != hand[i]) && (solutionCount < solutionLimit)) {
+	*square = piece;
+	solveLeft &= ~(1 << i);
+	return true;
+      }
+      ++i;
+    }
+
+    for (; (i < 5) && (solutionCount < solutionLimit); ++i) {
+      if (!(solveLeft & (1 << i)))
+	continue;
+      // Identical pieces would only find the same boards again
+      bool duplicate = false;
+      for (uint8_t j = 0; j < i; ++j)
+	if ((solveLeft & (1 << j)) && IsRotationOf(hand[i], hand[j]))
+	  duplicate = true;
+      if (duplicate)
+	continue;
+
+      *square = hand[i];
+      solveSlot[solveDepth - 1] = i;
+      solveLeft &= ~(1 << i);
+      return true;
+    }
+    *square = P_UNDECIDED;
+    --solveDepth;
+  }
+  return false;
+}
+
+/*
+ * SolveBegin
+ *
+ * Starts a search for ways to place every piece that isn't locked, both
+ * from the hand and already on the board, so the laser lights every
+ * piece that isn't a blocker. Pieces are only ever tried where the beam
+ * reaches, which keeps the search small. The search doesn't depend on
+ * where the movable pieces are, so the board and hand can change while
+ * it goes on.
+ *
+ * limit [in]
+ *   Stop searching after finding this many solutions
+ */
+void SolveBegin(const uint16_t limit)
+{
+  memcpy(solveBoard, board, sizeof(board));
+  memcpy(solveHand, hand, sizeof(hand));
+
+  // Gather up every piece that can be moved, and clear the board where they can go
+  solveLeft = 0;
+  for (uint8_t i = 0; i < 5; ++i)
+    if (solveHand[i] != P_BLANK)
+      solveLeft |= (1 << i);
+  for (uint8_t y = 0; y < boardHeight; ++y)
+    for (uint8_t x = 0; x < boardWidth; ++x)
+      if (!(solveBoard[y][x] & 0x80) || ((solveBoard[y][x] & 0x0F) == P_BLANK)) {
+	if (!(solveBoard[y][x] & 0x80) && (solveBoard[y][x] != P_BLANK))
+	  for (uint8_t i = 0; i < 5; ++i)
+	    if (!(solveLeft & (1 << i))) {
+	      solveHand[i] = solveBoard[y][x];
+	      solveLeft |= (1 << i);
+	      break;
+	    }
+	solveBoard[y][x] = P_UNDECIDED;
+      }
+
+  solutionCount = 0;
+  solutionPieces = 0;
+  solutionLimit = limit;
+  solveDepth = (limit > 0) ? 0 : SOLVE_DONE;
+}
+
+/*
+ * SolveStep
+ *
+ * Carries on with the search SolveBegin() started. The board and hand
+ * are left as they were, but laserIn[] is not.
+ *
+ * traces [in]
+ *   The most times to trace the beam before stopping
+ *
+ * Returns:
+ *   Whether the search is over. Once it is, solutionCount holds the
+ *   number of solutions found, and the first one is in solutionCell[]
+ *   and solutionPiece[].
+ */
+bool SolveStep(uint16_t traces)
+{
+  if (solveDepth == SOLVE_DONE)
+    return true;
+  SwapSolveBoard();
+  for (; traces; --traces)
+    if (!SolveDeeper() && !SolveNext()) {
+      solveDepth = SOLVE_DONE;
+      break;
+    }
+  SwapSolveBoard();
+  return (solveDepth == SOLVE_DONE);
+}
+
+// Searches all at once, and returns the number of solutions found
+uint16_t Solve(const uint16_t limit)
+{
+  SolveBegin(limit);
+  while (!SolveStep(UINT16_MAX))
+    ;
+  return solutionCount;
+}
+
+// Shows one piece that isn't where the search put it yet, using the drag-and-drop sprites
+static void ShowHint(void)
+{
+  if (solutionCount == 0)
+    return;
+  for (uint8_t i = 0; i < solutionPieces; ++i) {
+    uint8_t x = solutionCell[i] % BOARD_MAX_W;
+    uint8_t y = solutionCell[i] / BOARD_MAX_W;
+    if (board[y][x] != solutionPiece[i]) {
+      MapSprite2(MAX_SPRITES - 10, MapName(solutionPiece[i]), SPRITE_BANK1);
+      MoveSprite(MAX_SPRITES - 10, (9 + x * 4) * TILE_WIDTH, (1 + y * 4) * TILE_HEIGHT, 3, 3);
+      TriggerNote(4, 3, 23, 255);
+      return;
+    }
+  }
+}
+
+static void HideHint(void)
+{
+  for (uint8_t i = 0; i < 9; ++i)
+    sprites[i + MAX_SPRITES - 10].x = OFF_SCREEN;
+}
+
 int8_t old_piece = -1;
 int8_t old_x = -1;
 int8_t old_y = -1; // if this is 5, then it refers to hand
+uint8_t old_turns = 0; // how many times the piece has been turned clockwise since it was picked up
+
+#define X_LB (1 * TILE_WIDTH)
+#define X_UB ((SCREEN_TILES_H - 2) * TILE_WIDTH)
+#define Y_LB (1 * TILE_HEIGHT)
+#define Y_UB ((SCREEN_TILES_V - 2) * TILE_HEIGHT)
+
+/* The "mouse cursor" glides in 8.8 fixed point. It starts off at CUR_SPEED
+   pixels per frame, and speeds up by CUR_ACCEL every frame the direction is
+   held, up to CUR_MAX_SPEED. That stays under TILE_WIDTH, so the cursor
+   can't skip over a tile. The whole pixels are kept in the sprite itself,
+   and only the fractions and the velocities here.
+*/
+#define CUR_SPEED 0x0200
+#define CUR_ACCEL 0x0020
+#define CUR_MAX_SPEED 0x0600
+
+uint8_t cursorFracX = 0;
+uint8_t cursorFracY = 0;
+int16_t cursorVelocityX = 0;
+int16_t cursorVelocityY = 0;
+
+// Moves the cursor along one axis, toward dir (-1, 0, or 1), and returns the new position
+static uint8_t MoveAxis(const uint8_t pos, uint8_t* const frac, int16_t* const velocity, const int8_t dir,
+			const uint8_t lb, const uint8_t ub)
+{
+  if (dir == 0) {
+    *velocity = 0;
+    *frac = 0;
+    return pos;
+  }
+
+  if ((*velocity == 0) || ((*velocity < 0) != (dir < 0)))
+    *velocity = (dir < 0) ? -CUR_SPEED : CUR_SPEED;
+  else if ((*velocity < CUR_MAX_SPEED) && (*velocity > -CUR_MAX_SPEED))
+    *velocity += (dir < 0) ? -CUR_ACCEL : CUR_ACCEL;
+
+  uint16_t p = (((uint16_t)pos << 8) | *frac) + *velocity;
+  if (p < ((uint16_t)lb << 8)) {
+    p = (uint16_t)lb << 8;
+    *velocity = 0;
+  } else if (p > ((uint16_t)ub << 8)) {
+    p = (uint16_t)ub << 8;
+    *velocity = 0;
+  }
+  *frac = p & 0xFF;
+  return p >> 8;
+}
+
+static void MoveCursor(const BUTTON_INFO* const buttons)
+{
+  const int8_t dx = (buttons->held & BTN_RIGHT) ? 1 : (buttons->held & BTN_LEFT) ? -1 : 0;
+  const int8_t dy = (buttons->held & BTN_DOWN) ? 1 : (buttons->held & BTN_UP) ? -1 : 0;
+  sprites[MAX_SPRITES - 1].x = MoveAxis(sprites[MAX_SPRITES - 1].x, &cursorFracX, &cursorVelocityX, dx, X_LB, X_UB);
+  sprites[MAX_SPRITES - 1].y = MoveAxis(sprites[MAX_SPRITES - 1].y, &cursorFracY, &cursorVelocityY, dy, Y_LB, Y_UB);
+}
+
+/* In focus mode, the d-pad moves the focus between the squares of the
+   board, and a row below them made of the prev and next buttons and the
+   hand slots, and the cursor sits on whatever has the focus. Clicks and
+   rotations go straight to the focused square, with no need to work out
+   what is under the cursor. Holding a direction repeats the move, after a
+   delay.
+*/
+#define FOCUS_REPEAT_DELAY 15
+#define FOCUS_REPEAT_RATE 6
+#define FOCUS_HAND_ROW 5 // the same as old_y uses for the hand
+#define FOCUS_PREV (-2) // columns of the hand row that are to the left of the hand
+#define FOCUS_NEXT (-1)
+
+bool focusMode = false;
+int8_t focusCol = 0;
+int8_t focusRow = 0;
+static uint8_t focusRepeat = 0;
+
+// Puts the cursor on whatever has the focus
+static void PlaceFocusCursor(void)
+{
+  uint8_t x, y;
+  if (focusRow == FOCUS_HAND_ROW) {
+    x = (focusCol == FOCUS_PREV) ? PREV_NEXT_X : (focusCol == FOCUS_NEXT) ? (PREV_NEXT_X + 2) : (10 + focusCol * 4);
+    y = (focusCol < 0) ? PREV_NEXT_Y : 24;
+  } else {
+    x = 10 + focusCol * 4;
+    y = 2 + focusRow * 4;
+  }
+  sprites[MAX_SPRITES - 1].x = x * TILE_WIDTH;
+  sprites[MAX_SPRITES - 1].y = y * TILE_HEIGHT;
+}
+
+// Gives the focus to whatever the cursor is nearest to
+static void FocusOnCursor(void)
+{
+  const uint8_t tx = sprites[MAX_SPRITES - 1].x / TILE_WIDTH;
+  const uint8_t ty = sprites[MAX_SPRITES - 1].y / TILE_HEIGHT;
+  if (ty >= 22) {
+    focusRow = FOCUS_HAND_ROW;
+    focusCol = (tx < 9) ? ((tx < PREV_NEXT_X + 2) ? FOCUS_PREV : FOCUS_NEXT) : (tx - 9) / 4;
+    if (focusCol > 4)
+      focusCol = 4;
+  } else {
+    focusRow = (ty < 1) ? 0 : (ty - 1) / 4;
+    if (focusRow >= boardHeight)
+      focusRow = boardHeight - 1;
+    focusCol = (tx < 9) ? 0 : (tx - 9) / 4;
+    if (focusCol >= boardWidth)
+      focusCol = boardWidth - 1;
+  }
+  PlaceFocusCursor();
+}
+
+static void MoveFocus(const BUTTON_INFO* const buttons)
+{
+  const uint16_t dirs = BTN_UP | BTN_DOWN | BTN_LEFT | BTN_RIGHT;
+  uint16_t dir = buttons->pressed & dirs;
+  if (dir) {
+    focusRepeat = FOCUS_REPEAT_DELAY;
+  } else if ((buttons->held & dirs) && (--focusRepeat == 0)) {
+    dir = buttons->held & dirs;
+    focusRepeat = FOCUS_REPEAT_RATE;
+  }
+  if (!dir)
+    return;
+
+  if ((dir & BTN_UP) && (focusRow > 0))
+    focusRow = (focusRow == FOCUS_HAND_ROW) ? boardHeight - 1 : focusRow - 1;
+  else if ((dir & BTN_DOWN) && (focusRow != FOCUS_HAND_ROW))
+    focusRow = (focusRow == boardHeight - 1) ? FOCUS_HAND_ROW : focusRow + 1;
+  if (dir & BTN_LEFT)
+    --focusCol;
+  else if (dir & BTN_RIGHT)
+    ++focusCol;
+
+  const int8_t firstCol = (focusRow == FOCUS_HAND_ROW) ? FOCUS_PREV : 0;
+  const int8_t lastCol = (focusRow == FOCUS_HAND_ROW) ? 4 : boardWidth - 1;
+  if (focusCol < firstCol)
+    focusCol = firstCol;
+  if (focusCol > lastCol)
+    focusCol = lastCol;
+
+  PlaceFocusCursor();
+}
+
+// What the cursor is over, for clicks, drops and rotations
+#define TARGET_NONE 0
+#define TARGET_BOARD 1
+#define TARGET_HAND 2
+#define TARGET_PREV 3
+#define TARGET_NEXT 4
+
+/*
+ * CursorTarget
+ *
+ * Works out what a click or rotation applies to: the focus in focus
+ * mode, or else whatever is under the "mouse cursor".
+ *
+ * x [out]
+ *   The column of the square, or the hand slot
+ *
+ * y [out]
+ *   The row of the square, or 5 for the hand
+ *
+ * Returns:
+ *   One of the TARGET_* values
+ */
+static uint8_t CursorTarget(int8_t* const x, int8_t* const y)
+{
+  if (focusMode) {
+    *x = focusCol;
+    *y = focusRow;
+    if (focusRow != FOCUS_HAND_ROW)
+      return TARGET_BOARD;
+    return (focusCol == FOCUS_PREV) ? TARGET_PREV : (focusCol == FOCUS_NEXT) ? TARGET_NEXT : TARGET_HAND;
+  }
+
+  const uint8_t tx = sprites[MAX_SPRITES - 1].x / TILE_WIDTH;
+  const uint8_t ty = sprites[MAX_SPRITES - 1].y / TILE_HEIGHT;
+  if ((ty == PREV_NEXT_Y) || (ty == PREV_NEXT_Y + 1)) {
+    if ((tx >= PREV_NEXT_X) && (tx <= PREV_NEXT_X + 1))
+      return TARGET_PREV;
+    if ((tx >= PREV_NEXT_X + 2) && (tx <= PREV_NEXT_X + 3))
+      return TARGET_NEXT;
+  }
+  if ((tx < 9) || (tx > 27))
+    return TARGET_NONE;
+  *x = pgm_read_byte(&hitMap[tx - 9]);
+  if (*x < 0)
+    return TARGET_NONE;
+  if ((ty >= 1) && (ty <= 19)) { // grid
+    *y = pgm_read_byte(&hitMap[ty - 1]);
+    if ((*y >= 0) && (*x < boardWidth) && (*y < boardHeight))
+      return TARGET_BOARD;
+  } else if ((ty >= 23) && (ty <= 25)) { // hand
+    *y = 5;
+    return TARGET_HAND;
+  }
+  return TARGET_NONE;
+}
+
+static void JournalMove(const uint8_t from, const uint8_t to, const uint8_t turns)
+{
+  journal[journalHead] = JOURNAL_ENTRY(from, to, turns);
+  journalHead = (journalHead + 1) & (JOURNAL_SIZE - 1);
+  if (journalUndo < JOURNAL_SIZE)
+    ++journalUndo;
+  journalRedo = 0;
+}
+
+static uint8_t* JournalSquare(const uint8_t square)
+{
+  return (square < JOURNAL_HAND) ? &board[square / BOARD_MAX_W][square % BOARD_MAX_W] : &hand[square - JOURNAL_HAND];
+}
+
+static void DrawJournalSquare(const uint8_t square)
+{
+  if (square < JOURNAL_HAND) {
+    DrawMap(9 + (square % BOARD_MAX_W) * 4, 1 + (square / BOARD_MAX_W) * 4, MapName(*JournalSquare(square)));
+    SQUARE_REDRAWN(square % BOARD_MAX_W, square / BOARD_MAX_W);
+  } else {
+    DrawMap(9 + (square - JOURNAL_HAND) * 4, 23, MapName(*JournalSquare(square)));
+  }
+}
+
+// Moves a piece from one square to another, turning it on the way, and redraws just those squares
+static void ReplayMove(const uint8_t from, const uint8_t to, uint8_t turns, const uint8_t* const rotation_lut)
+{
+  uint8_t piece = *JournalSquare(from);
+  for (; turns; --turns)
+    piece = pgm_read_byte(&rotation_lut[piece]);
+  *JournalSquare(from) = P_BLANK;
+  *JournalSquare(to) = piece;
+  DrawJournalSquare(from);
+  if (to != from)
+    DrawJournalSquare(to);
+  TriggerNote(4, 3, 23, 255);
+}
+
+static void Undo(void)
+{
+  if (journalUndo == 0)
+    return;
+  journalHead = (journalHead - 1) & (JOURNAL_SIZE - 1);
+  --journalUndo;
+  ++journalRedo;
+  const uint16_t entry = journal[journalHead];
+  ReplayMove((entry >> 5) & 0x1F, entry & 0x1F, entry >> 10, rotateCounterClockwise);
+}
+
+static void Redo(void)
+{
+  if (journalRedo == 0)
+    return;
+  const uint16_t entry = journal[journalHead];
+  journalHead = (journalHead + 1) & (JOURNAL_SIZE - 1);
+  --journalRedo;
+  ++journalUndo;
+  ReplayMove(entry & 0x1F, (entry >> 5) & 0x1F, entry >> 10, rotateClockwise);
+}
 
 void TryRotation(const uint8_t* rotation_lut)
 {
   if (old_piece == -1) { // nothing being dragged and dropped
-    uint8_t tx = sprites[MAX_SPRITES - 1].x / TILE_WIDTH;
-    uint8_t ty = sprites[MAX_SPRITES - 1].y / TILE_HEIGHT;
-    if ((ty >= 1) && (ty <= 19) && (tx >= 9) && (tx <= 27)) { // from grid
-      int8_t x = pgm_read_byte(&hitMap[tx - 9]);
-      int8_t y = pgm_read_byte(&hitMap[ty - 1]);
-      if ((x >= 0) && (y >= 0) && !(board[y][x] & 0x80)) { // respect lock bit
-	board[y][x] = pgm_read_byte(&rotation_lut[board[y][x]]);
-	DrawMap(9 + x * 4, 1 + y * 4, MapName(board[y][x]));
-	TriggerNote(4, 3, 23, 255);
-      }
-    } else if ((ty >= 23) && (ty <= 25) && (tx >= 9) && (tx <= 27)) {
-      int8_t x = pgm_read_byte(&hitMap[tx - 9]);
-      if (x >= 0) {
-	hand[x] = pgm_read_byte(&rotation_lut[hand[x]]);
-	DrawMap(9 + x * 4, 23, MapName(hand[x]));
-	TriggerNote(4, 3, 23, 255);
-      }
+    int8_t x, y;
+    const uint8_t target = CursorTarget(&x, &y);
+    const uint8_t turns = (rotation_lut == rotateClockwise) ? 1 : 3;
+    if ((target == TARGET_BOARD) && !(board[y][x] & 0x80) && // respect lock bit
+	(board[y][x] != P_BLANK) && (board[y][x] != P_BLOCKER)) { // turning those changes nothing, so it isn't a move
+      board[y][x] = pgm_read_byte(&rotation_lut[board[y][x]]);
+      DrawMap(9 + x * 4, 1 + y * 4, MapName(board[y][x]));
+      SQUARE_REDRAWN(x, y);
+      JournalMove(y * BOARD_MAX_W + x, y * BOARD_MAX_W + x, turns);
+      CountMove();
+      TriggerNote(4, 3, 23, 255);
+    } else if ((target == TARGET_HAND) && (hand[x] != P_BLANK) && (hand[x] != P_BLOCKER)) {
+      // Turning a blank or a blocker changes nothing, so it would only journal an empty undo step, and lose the redo history
+      hand[x] = pgm_read_byte(&rotation_lut[hand[x]]);
+      DrawMap(9 + x * 4, 23, MapName(hand[x]));
+      JournalMove(JOURNAL_HAND + x, JOURNAL_HAND + x, turns);
+      TriggerNote(4, 3, 23, 255);
     }
   } else {
     old_piece = pgm_read_byte(&rotation_lut[old_piece]);
+    old_turns = (old_turns + ((rotation_lut == rotateClockwise) ? 1 : 3)) & 3;
     MapSprite2(MAX_SPRITES - 10, MapName(old_piece), SPRITE_BANK1);
     MoveSprite(MAX_SPRITES - 10, sprites[MAX_SPRITES - 1].x - 8, sprites[MAX_SPRITES - 1].y - 8, 3, 3);
     TriggerNote(4, 3, 23, 255);
   }
 }
 
+/* Celebration
+ *
+ * Winning a level shows a thumbs up for a few seconds, then flashes the
+ * next button until the level changes. It advances a frame at a time from
+ * the main loop, so the controls keep working the whole time, and the next
+ * level can be picked straight away.
+ */
+#define CELEBRATION_FRAMES 180
+#define FLASH_FRAMES 40
+
+enum { CELEBRATE_NONE, CELEBRATE_THUMBS_UP, CELEBRATE_FLASH };
+
+uint8_t celebration = CELEBRATE_NONE;
+uint8_t celebrationCounter = 0;
+
+static void ShowThumb(const bool up)
+{
+  sprites[2].tileIndex = 12;
+  sprites[2].flags = up ? 0 : SPRITE_FLIP_Y;
+  sprites[2].x = 4 * TILE_WIDTH;
+  sprites[2].y = (2 * TILE_WIDTH) + 4;
+}
+
+static void Celebrate(void)
+{
+  TriggerNote(4, 5, 15, 255);
+  ShowThumb(true);
+  celebration = CELEBRATE_THUMBS_UP;
+  celebrationCounter = 0;
+}
+
+static void StepCelebration(const BUTTON_INFO* const buttons)
+{
+  switch (celebration) {
+  case CELEBRATE_THUMBS_UP:
+    if (++celebrationCounter == CELEBRATION_FRAMES) {
+      if (!(buttons->held & BTN_Y)) // otherwise it goes when the laser is turned off
+	sprites[2].x = OFF_SCREEN;
+      celebration = CELEBRATE_FLASH;
+      celebrationCounter = 0;
+    }
+    break;
+  case CELEBRATE_FLASH:
+    if (celebrationCounter == 0)
+      DrawMap(PREV_NEXT_X + 2, PREV_NEXT_Y, map_next_red);
+    else if (celebrationCounter == FLASH_FRAMES / 2 - 1)
+      DrawMap(PREV_NEXT_X, PREV_NEXT_Y, map_prev_next);
+    if (++celebrationCounter == FLASH_FRAMES)
+      celebrationCounter = 0;
+    break;
+  }
+}
+
+// Checks the beam that was just traced, and celebrates if it solves the puzzle
+static void JudgeBoard(const uint16_t level)
+{
+  if (IsSolved()) {
+    LevelWon(level);
+    Celebrate();
+  } else {
+    ShowThumb(false);
+  }
+}
+
 int main()
 {
   BUTTON_INFO buttons;
@@ -1369,8 +1955,7 @@ int main()
     if ((buttons.pressed & BTN_A) || (buttons.pressed & BTN_START))
       break;
   }
-  
-  memset(&buttons, 0, sizeof(BUTTON_INFO));
+  // The buttons that left the title screen are still held, so they don't count as pressed again
 
   SetTileTable(tileset);
   SetSpritesTileBank(0, mysprites);
@@ -1379,202 +1964,215 @@ int main()
 
   StartSong(midisong);
 
-  uint8_t currentLevel = 1;
-  LoadLevel(currentLevel, false);
+#if LEVEL_PACK
+  OpenLevelPack();
+#endif
+  LoadProgress();
+  uint16_t currentLevel = levelPack ? 1 : progress[PROGRESS_LAST_LEVEL];
+  LoadLevel(currentLevel);
+  SolveBegin(1);
+#if LIVE_LASER
+  ShowLiveLaser();
+#endif
   
   sprites[MAX_SPRITES - 1].tileIndex = 1;
   sprites[MAX_SPRITES - 1].x = 7 * TILE_WIDTH;
   sprites[MAX_SPRITES - 1].y = 24 * TILE_HEIGHT;
+#if !LIVE_LASER
   uint8_t saved_cursor_x = 0;
+#endif
 
-  bool flashNext = false;
-  uint8_t flashCounter = 0;
-  
+  bool laserOn = false; // whether the beam is still being drawn
+  bool hintWanted = false; // SELECT is held, but the search for the hint isn't over yet
+
+  PROFILE_INIT();
   for (;;) {
     WaitVsync(1);
+    PROFILE_FRAME();
  
     // Read the current state of the player's controller
     buttons.prev = buttons.held;
     buttons.held = ReadJoypad(0);
+    PROFILE_BEGIN(); // the kernel has already read the joypad, so it's the decoding that's timed
     buttons.pressed = buttons.held & (buttons.held ^ buttons.prev);
     buttons.released = buttons.prev & (buttons.held ^ buttons.prev);
+    PROFILE_END(PROFILE_INPUT);
+
+    StepCelebration(&buttons);
 
-    // This "solution view" is for debug purposes only!
-    /* if (buttons.pressed & BTN_START) */
-    /*   LoadLevel(currentLevel, true); */
-    /* if (buttons.released & BTN_START) */
-    /*   LoadLevel(currentLevel, false); */
-
-    if (flashNext) {
-      if (flashCounter == 0)
-	DrawMap(PREV_NEXT_X + 2, PREV_NEXT_Y, map_next_red);
-      else if (flashCounter == 19)
-	DrawMap(PREV_NEXT_X, PREV_NEXT_Y, map_prev_next);
-      else if (flashCounter == 39)
-	flashCounter = 255;
-      ++flashCounter;
-    }
-    
     if (buttons.pressed & BTN_Y) {
+#if LIVE_LASER
+      if (old_piece == -1) { // the beam is already on the screen, so it only has to be checked, but not with a piece in flight
+	PROFILE_BEGIN();
+	UpdateLiveLaser(); // the hint solver traces boards of its own, so this traces the one on the screen again
+	PROFILE_END(PROFILE_TRACE);
+	JudgeBoard(currentLevel);
+      }
+#else
       // Hide the cursor when the laser is on
       saved_cursor_x = sprites[MAX_SPRITES - 1].x;
 
-      if (!(buttons.held & BTN_A)) { // Don't turn the laser on if you are dragging and dropping
+      if (old_piece == -1) { // Don't turn the laser on if you are dragging and dropping (in focus mode, A isn't held for that)
 	sprites[MAX_SPRITES - 1].x = OFF_SCREEN;
-	memset(laser, 0, sizeof(laser));
-	for (uint8_t i = 0; i < 100; ++i)
-	  SimulatePhoton();
-      
-	DrawLaser();
-	// Check to see if the puzzle has been solved
-	const uint16_t offset = (currentLevel - 1) * LEVEL_SIZE + 25;
-	bool win = true;
-	for (uint8_t y = 0; y < 5; ++y)
-	  for (uint8_t x = 0; x < 5; ++x) {
-	    uint8_t piece = (uint8_t)pgm_read_byte(&levelData[offset + y * 5 + x]);
-	    if ((board[y][x] & 0x0F) != piece)
-	      win = false;
-	  }
-	if (win) {
-	  TriggerNote(4, 5, 15, 255);
-	  flashNext = true;
-	  sprites[2].tileIndex = 12;
-	  sprites[2].flags = 0;
-	  sprites[2].x = 4 * TILE_WIDTH;
-	  sprites[2].y = (2 * TILE_WIDTH) + 4;
-	  WaitVsync(180);
-	} else {
-	  sprites[2].tileIndex = 12;
-	  sprites[2].flags = SPRITE_FLIP_Y;
-	  sprites[2].x = 4 * TILE_WIDTH;
-	  sprites[2].y = (2 * TILE_WIDTH) + 4;	  
-	}
+	PROFILE_BEGIN();
+	TraceLaser();
+	PROFILE_END(PROFILE_TRACE);
+	laserOn = true;
       }
+#endif
     } else if (buttons.released & BTN_Y) {
+#if !LIVE_LASER
+      laserOn = false;
+      PROFILE_BEGIN();
       EraseLaser();
-      sprites[2].x = OFF_SCREEN;
+      PROFILE_END(PROFILE_ERASE);
+#endif
+      if (celebration != CELEBRATE_THUMBS_UP) // the thumbs up stays for the whole of its time
+	sprites[2].x = OFF_SCREEN;
+#if !LIVE_LASER
       // Restore the cursor when the laser is off
       sprites[MAX_SPRITES - 1].x = saved_cursor_x;
+#endif
+    }
+
+    // Draw the beam a little more each frame, and once it's all there, see if the puzzle is solved
+    if (laserOn) {
+      PROFILE_BEGIN();
+      const bool drawn = DrawLaserStep();
+      PROFILE_END(PROFILE_DRAW);
+      if (drawn) {
+	laserOn = false;
+	JudgeBoard(currentLevel);
+      }
     }
         
-#define CUR_SPEED 2
-#define X_LB (1 * TILE_WIDTH)
-#define X_UB ((SCREEN_TILES_H - 2) * TILE_WIDTH)
-#define Y_LB (1 * TILE_HEIGHT)
-#define Y_UB ((SCREEN_TILES_V - 2) * TILE_HEIGHT)
-    
     if (!(buttons.held & BTN_Y)) { // Don't allow the hidden cursor to be moved if the laser is on
     
-      // Move the "mouse cursor"
-      if (buttons.held & BTN_RIGHT) {
-	uint8_t x = sprites[MAX_SPRITES - 1].x;
-	x += CUR_SPEED;
-	if (x > X_UB)
-	  x = X_UB;
-	sprites[MAX_SPRITES - 1].x = x;
-      } else if (buttons.held & BTN_LEFT) {
-	uint8_t x = sprites[MAX_SPRITES - 1].x;
-	x -= CUR_SPEED;
-	if (x < X_LB)
-	  x = X_LB;
-	sprites[MAX_SPRITES - 1].x = x;
-      }
-      if (buttons.held & BTN_UP) {
-	uint8_t y = sprites[MAX_SPRITES - 1].y;
-	y -= CUR_SPEED;
-	if (y < Y_LB)
-	  y = Y_LB;
-	sprites[MAX_SPRITES - 1].y = y;
-      } else if (buttons.held & BTN_DOWN) {
-	uint8_t y = sprites[MAX_SPRITES - 1].y;
-	y += CUR_SPEED;
-	if (y > Y_UB)
-	  y = Y_UB;
-	sprites[MAX_SPRITES - 1].y = y;
+      // Start toggles between gliding the "mouse cursor" and moving the focus from square to square
+      if (buttons.pressed & BTN_START) {
+	focusMode = !focusMode;
+	if (focusMode)
+	  FocusOnCursor();
       }
+      if (focusMode)
+	MoveFocus(&buttons);
+      else
+	MoveCursor(&buttons);
+
       // Dragging
       if (old_piece != -1) {
+	PROFILE_BEGIN();
 	MoveSprite(MAX_SPRITES - 10, sprites[MAX_SPRITES - 1].x - 8, sprites[MAX_SPRITES - 1].y - 8, 3, 3);
+	PROFILE_END(PROFILE_DRAG);
       }
     }
 
-    // Process rotations
+    // Process rotations, and undo (left shoulder) and redo (right shoulder)
+    PROFILE_BEGIN();
     if (!(buttons.held & BTN_Y)) { // Don't process rotations if the laser is on
-      if ((buttons.pressed & BTN_X) || (buttons.pressed & BTN_SR))
+      if (buttons.pressed & BTN_X)
 	TryRotation(rotateClockwise);
-      else if ((buttons.pressed & BTN_B) || (buttons.pressed & BTN_SL))
+      else if (buttons.pressed & BTN_B)
 	TryRotation(rotateCounterClockwise);
+      else if ((buttons.pressed & BTN_SL) && (old_piece == -1))
+	Undo();
+      else if ((buttons.pressed & BTN_SR) && (old_piece == -1))
+	Redo();
     }
+    PROFILE_END(PROFILE_ROTATE);
     
-    // Process any "mouse" clicks
-    if (buttons.pressed & BTN_A) {
-      uint8_t tx = sprites[MAX_SPRITES - 1].x / TILE_WIDTH;
-      uint8_t ty = sprites[MAX_SPRITES - 1].y / TILE_HEIGHT;
-      if ((ty == PREV_NEXT_Y) || (ty == PREV_NEXT_Y + 1)) {
-	if ((tx >= PREV_NEXT_X) && (tx <= PREV_NEXT_X + 1)) {
+    // Show where a piece goes while SELECT is held (not while dragging, or with the laser on)
+    if ((buttons.pressed & BTN_SELECT) && (old_piece == -1) && !(buttons.held & BTN_Y)) {
+      hintWanted = true;
+    } else if (buttons.released & BTN_SELECT) {
+      hintWanted = false;
+      if (old_piece == -1)
+	HideHint();
+    }
+
+    // The hint is searched for a little each frame, but not while the beam needs laserIn[]
+    if (!laserOn && !(buttons.held & BTN_Y)) {
+      PROFILE_BEGIN();
+      const bool searched = SolveStep(HINT_TRACES_PER_FRAME);
+      PROFILE_END(PROFILE_HINT);
+      if (searched && hintWanted && (old_piece == -1)) {
+	hintWanted = false;
+	ShowHint();
+      }
+    }
+
+    // Process any "mouse" clicks. With the mouse, pieces are dragged while A is held,
+    // but in focus mode, A picks a piece up, and A again puts it down. Nothing is
+    // dropped while the laser is on, so if A is let go then, the piece goes down with Y.
+    const bool pickUp = (buttons.pressed & BTN_A) && (old_piece == -1) && !(buttons.held & BTN_Y);
+    const bool drop = (old_piece != -1) && !(buttons.held & BTN_Y) &&
+      (focusMode ? (buttons.pressed & BTN_A) :
+       ((buttons.released & BTN_A) || ((buttons.released & BTN_Y) && !(buttons.held & BTN_A))));
+    if (pickUp) {
+      int8_t x, y;
+      const uint8_t target = CursorTarget(&x, &y);
+      if ((target == TARGET_PREV) || (target == TARGET_NEXT)) {
+	if (target == TARGET_PREV) {
 	  if (--currentLevel == 0)
-	    currentLevel = LEVELS;
-	  TriggerNote(4, 3, 23, 255);
-	  flashNext = false;
-	  flashCounter = 0;
-	  LoadLevel(currentLevel, false);
-	}
-	if ((tx >= PREV_NEXT_X + 2) && (tx <= PREV_NEXT_X + 3)) {
-	  if (++currentLevel == LEVELS + 1)
+	    currentLevel = levelCount;
+	} else {
+	  if (++currentLevel == levelCount + 1)
 	    currentLevel = 1;
-	  TriggerNote(4, 3, 23, 255);
-	  flashNext = false;
-	  flashCounter = 0;
-	  LoadLevel(currentLevel, false);
-	}	
+	}
+	TriggerNote(4, 3, 23, 255);
+	celebration = CELEBRATE_NONE;
+	PROFILE_BEGIN();
+#if LIVE_LASER
+	HideLiveLaser();
+#endif
+	ChangeLevel(currentLevel);
+	SolveBegin(1);
+#if LIVE_LASER
+	ShowLiveLaser();
+#endif
+	PROFILE_END(PROFILE_LOAD);
       }
 
       // Drag and drop
-      if ((ty >= 1) && (ty <= 19) && (tx >= 9) && (tx <= 27)) { // from grid
-	int8_t x = pgm_read_byte(&hitMap[tx - 9]);
-	int8_t y = pgm_read_byte(&hitMap[ty - 1]);
-	if ((x >= 0) && (y >= 0) && !(board[y][x] & 0x80) && (board[y][x] != P_BLANK)) { // respect lock bit
-	  old_piece = board[y][x];
-	  old_x = x;
-	  old_y = y;
-	  DrawMap(9 + x * 4, 1 + y * 4, map_blank);
-	  board[y][x] = P_BLANK;
-	  MapSprite2(MAX_SPRITES - 10, MapName(old_piece), SPRITE_BANK1);
-	  MoveSprite(MAX_SPRITES - 10, sprites[MAX_SPRITES - 1].x - 8, sprites[MAX_SPRITES - 1].y - 8, 3, 3);
-	  TriggerNote(4, 3, 23, 255);
-	}
-      } else if ((ty >= 23) && (ty <= 25) && (tx >= 9) && (tx <= 27)) { // from hand
-	int8_t x = pgm_read_byte(&hitMap[tx - 9]);
-	if ((x >= 0) && (hand[x] != P_BLANK)) {
-	  old_piece = hand[x];
-	  old_x = x;
-	  old_y = 5; // this piece came from hand
-	  DrawMap(9 + x * 4, 23, map_blank);
-	  hand[x] = P_BLANK;
-	  MapSprite2(MAX_SPRITES - 10, MapName(old_piece), SPRITE_BANK1);
-	  MoveSprite(MAX_SPRITES - 10, sprites[MAX_SPRITES - 1].x - 8, sprites[MAX_SPRITES - 1].y - 8, 3, 3);
-	  TriggerNote(4, 3, 23, 255);
-	}
+      PROFILE_BEGIN();
+      if ((target == TARGET_BOARD) && !(board[y][x] & 0x80) && (board[y][x] != P_BLANK)) { // respect lock bit
+	old_piece = board[y][x];
+	old_x = x;
+	old_y = y;
+	old_turns = 0;
+	DrawMap(9 + x * 4, 1 + y * 4, map_blank);
+	SQUARE_REDRAWN(x, y);
+	board[y][x] = P_BLANK;
+	MapSprite2(MAX_SPRITES - 10, MapName(old_piece), SPRITE_BANK1);
+	MoveSprite(MAX_SPRITES - 10, sprites[MAX_SPRITES - 1].x - 8, sprites[MAX_SPRITES - 1].y - 8, 3, 3);
+	TriggerNote(4, 3, 23, 255);
+      } else if ((target == TARGET_HAND) && (hand[x] != P_BLANK)) {
+	old_piece = hand[x];
+	old_x = x;
+	old_y = 5; // this piece came from hand
+	old_turns = 0;
+	DrawMap(9 + x * 4, 23, map_blank);
+	hand[x] = P_BLANK;
+	MapSprite2(MAX_SPRITES - 10, MapName(old_piece), SPRITE_BANK1);
+	MoveSprite(MAX_SPRITES - 10, sprites[MAX_SPRITES - 1].x - 8, sprites[MAX_SPRITES - 1].y - 8, 3, 3);
+	TriggerNote(4, 3, 23, 255);
       }
+      PROFILE_END(PROFILE_DRAG);
       
-    } else if (buttons.released & BTN_A) {
-      if ((old_piece != -1) && (old_y != -1)) { // valid piece is being held
-	uint8_t tx = sprites[MAX_SPRITES - 1].x / TILE_WIDTH;
-	uint8_t ty = sprites[MAX_SPRITES - 1].y / TILE_HEIGHT;
+    } else if (drop) {
+      PROFILE_BEGIN();
+      if (old_y != -1) { // valid piece is being held
+	const int8_t from_x = old_x;
+	const int8_t from_y = old_y;
 	// Figure out where to drop it
-	if ((ty >= 1) && (ty <= 19) && (tx >= 9) && (tx <= 27)) { // to grid
-	  int8_t x = pgm_read_byte(&hitMap[tx - 9]);
-	  int8_t y = pgm_read_byte(&hitMap[ty - 1]);
-	  if ((x >= 0) && (y >= 0) && ((board[y][x] & 0x0F) == P_BLANK)) {
-	    old_x = x;
-	    old_y = y;
-	  }
-	} else if ((ty >= 23) && (ty <= 25) && (tx >= 9) && (tx <= 27)) { // to hand
-	  int8_t x = pgm_read_byte(&hitMap[tx - 9]);
-	  if ((x >= 0) && ((hand[x] & 0x0F) == P_BLANK)) {
-	    old_x = x;
-	    old_y = 5; // hand
-	  }
+	int8_t x, y;
+	const uint8_t target = CursorTarget(&x, &y);
+	if ((target == TARGET_BOARD) && ((board[y][x] & 0x0F) == P_BLANK)) {
+	  old_x = x;
+	  old_y = y;
+	} else if ((target == TARGET_HAND) && ((hand[x] & 0x0F) == P_BLANK)) {
+	  old_x = x;
+	  old_y = 5; // hand
 	}
 	
 	// Drop it like it's hot
@@ -1585,12 +2183,28 @@ int main()
 	  hand[old_x] = old_piece;
 	} else {
 	  DrawMap(9 + old_x * 4, 1 + old_y * 4, MapName(old_piece));
+	  SQUARE_REDRAWN(old_x, old_y);
 	  board[old_y][old_x] = old_piece;
 	}
+	if ((old_x != from_x) || (old_y != from_y))
+	  CountMove();
+	if ((old_x != from_x) || (old_y != from_y) || old_turns)
+	  JournalMove((from_y == 5) ? (JOURNAL_HAND + from_x) : (from_y * BOARD_MAX_W + from_x),
+		      (old_y == 5) ? (JOURNAL_HAND + old_x) : (old_y * BOARD_MAX_W + old_x), old_turns);
 	old_piece = old_x = old_y = -1;
 	TriggerNote(4, 4, 23, 255);
       }
+      PROFILE_END(PROFILE_DRAG);
+    }
+
+#if LIVE_LASER
+    // Bring the beam up to date with whatever moved this frame
+    if (squaresRedrawn) {
+      PROFILE_BEGIN();
+      UpdateLiveLaser();
+      PROFILE_END(PROFILE_DRAW);
     }
+#endif
     
   }
 }